@@ -1,4 +1,7 @@
 #include <string>
+#include <string.h>
+#include <limits.h>
+#include <stdio.h>
 #include <iostream>
 #include <fstream>
 #include <vector>
@@ -14,6 +17,8 @@
 
 #include "gui_draw.h"
 #include "gui.h"
+#include "gui_state.h"
+#include "gui_text.h"
 
 
 GUI_AABB GUI_AABB::fromPositionSize(float x, float y, float w, float h)
@@ -73,6 +78,11 @@ GUI_AABB GUI_AABB::intersection(const GUI_AABB &o) const
     return GUI_AABB(minp, maxp);
 }
 
+bool GUI_AABB::isEmpty() const
+{
+    return max[0] <= min[0] || max[1] <= min[1];
+}
+
 float GUI_AABB::getWidth() const
 {
     return max[0] - min[0];
@@ -84,6 +94,27 @@ float GUI_AABB::getHeight() const
 }
 
 
+GUIHash GUI_HashBytes(const char *s, size_t len, GUIHash h)
+{
+    for(size_t i = 0; i < len; i++)
+        h = (h ^ (unsigned char)s[i]) * GUI_HASH_PRIME;
+
+    return h;
+}
+
+GUIID::GUIID(const char *s)
+{
+    hash = GUI_HashBytes(s, strlen(s));
+    name = s;
+}
+
+GUIID::GUIID(const std::string &s)
+{
+    hash = GUI_HashBytes(s.data(), s.size());
+    name = s.c_str();
+}
+
+
 GUIEditBoxData::GUIEditBoxData()
 {
     caret_pos = 0;
@@ -108,15 +139,31 @@ GUIEditBoxData::GUIEditBoxData(const std::string &s)
     str = s;
 }
 
+GUITextEditorData::GUITextEditorData()
+{
+    caret = anchor = 0;
+    scroll = 0;
+    offset = 0.0f;
+    text_ptr = NULL;
+}
+
+GUITextEditorData::GUITextEditorData(GUITextBuffer *t)
+{
+    caret = anchor = 0;
+    scroll = 0;
+    offset = 0.0f;
+    text_ptr = t;
+}
+
 
 
 void GUIDirContents::add(const std::string &name, const std::string type, const std::string size, bool is_file)
 {
-    names.push_back(name);
-    types.push_back(type);
-    sizes.push_back(size);
-    dirfile.push_back(is_file ? "f" : "d");
-    selected.push_back(false);
+    names.add(name);
+    types.add(type);
+    sizes.add(size);
+    dirfile.add(is_file ? "f" : "d", 1);
+    selected.resize(names.size());
 }
 
 void GUIDirContents::clear()
@@ -126,6 +173,7 @@ void GUIDirContents::clear()
     sizes.clear();
     dirfile.clear();
     selected.clear();
+    selected.resize(0);
 }
 
 void GUIDirContents::sort()
@@ -148,22 +196,30 @@ std::string GUIFileChooserData::getFile()
     return file_edit_data.str;
 }
 
-std::vector<std::string> GUIFileChooserData::getSelectedFiles()
+/* selected entries of one kind, visiting only the selected ranges */
+static std::vector<std::string> selectedOfType(const GUIDirContents &c, char type)
 {
     std::vector<std::string> strs;
-    for(size_t i = 0; i < contents.names.size(); i++)
-        if(contents.selected[i] && contents.dirfile[i] == "f")
-            strs.push_back(contents.names[i]);
+    const GUISelection &s = c.selected;
+
+    for(int b = s.nextSelected(0); b < s.count(); b = s.nextSelected(b))
+    {
+        for(int e = s.rangeEnd(b); b < e; b++)
+            if(c.dirfile[b][0] == type)
+                strs.push_back(c.names[b]);
+    }
+
     return strs;
 }
 
+std::vector<std::string> GUIFileChooserData::getSelectedFiles()
+{
+    return selectedOfType(contents, 'f');
+}
+
 std::vector<std::string> GUIFileChooserData::getSelectedDirs()
 {
-    std::vector<std::string> strs;
-    for(size_t i = 0; i < contents.names.size(); i++)
-        if(contents.selected[i] && contents.dirfile[i] == "d")
-            strs.push_back(contents.names[i]);
-    return strs;
+    return selectedOfType(contents, 'd');
 }
 
 
@@ -186,6 +242,7 @@ struct GUIKeyboardState
 {
     bool is_key_typed;
     int key_typed;
+    std::string text;   /* UTF-8 run from GUI_TextInput() */
     sf::Key::Code key_pressed;
     bool alt, control, shift;
 };
@@ -196,8 +253,15 @@ extern sf::RenderWindow window;
 static GUIMouseState mouse;
 static GUIKeyboardState keyboard;
 
-static std::string hot_widget;
-static std::string active_widget;
+static GUIHash hot_widget;
+static GUIHash active_widget;
+
+/*
+ * Maps widget hashes back to their id strings for GUI_HotWidget() and
+ * GUI_ActiveWidget(). Only filled in while debug names are enabled.
+ */
+static bool debug_names_enabled = false;
+static std::map<GUIHash, std::string> debug_names;
 
 static int active_widget_layer;
 static int hot_widget_layer;
@@ -210,14 +274,57 @@ static int layer;
  */
 static int pass;
 
+/*
+ * Set while the GUI is run with GUI_PASS_SINGLE. Input then accumulates until
+ * the end of the next pass instead of each event replacing the last one.
+ */
+static bool single_pass_mode = false;
+
+/*
+ * Hot widget candidates found during a GUI_PASS_SINGLE. They become the hot
+ * widget at the end of the pass, so widgets always respond to the hot widget
+ * of the previous frame.
+ */
+static GUIHash next_hot_widget;
+static int next_hot_widget_layer;
+static bool next_is_mouse_in;
+
+/*
+ * Bit mask of the kinds of queued input applied since the last single pass.
+ * See GUI_ProcessInput().
+ */
+static int frame_input = 0;
+
+/*
+ * Redraw tracking. A frame needs drawing if input arrived since the last draw
+ * pass, the host asked for one, or the last draw pass produced different
+ * commands than the one before it.
+ */
+static bool input_since_draw = true;
+static bool redraw_requested = true;
+static bool last_frame_changed = true;
+static GUIRedrawStats redraw_stats;
+
+static bool isEventPass()       { return pass == GUI_PASS_EVENT    || pass == GUI_PASS_SINGLE; }
+static bool isResponsePass()    { return pass == GUI_PASS_RESPONSE || pass == GUI_PASS_SINGLE; }
+static bool isDrawPass()        { return pass == GUI_PASS_DRAW     || pass == GUI_PASS_SINGLE; }
+
 
 /*
  * Stores all pushed desired clipping rectangles and the current one. The
- * current desired clipping rectangle is always clip_stack.top. clip_rect might
- * be different from the desired clipping rectangle since it gets clipped to
- * the screen_rect.
+ * current desired clipping rectangle is always clip_stack.top. Each desired
+ * rectangle has already been intersected with its parent unless it was pushed
+ * on a higher layer, since things like drop lists float over the group they
+ * belong to. clip_rect might be different from the desired clipping rectangle
+ * since it gets clipped to the screen_rect.
  */
-static std::stack<GUI_AABB> clip_stack;
+struct ClipEntry
+{
+    GUI_AABB rect;
+    int layer;
+};
+
+static std::stack<ClipEntry> clip_stack;
 
 /*
  * The current clipping rectangle to actually use.
@@ -244,6 +351,8 @@ static int button_mode;
 static std::stack<int> button_mode_stack;
 
 static float listbox_item_height = 20.0f;
+static float editor_line_height = 20.0f;
+static float log_line_height = 16.0f;
 
 static int event_bits = 0;
 
@@ -251,6 +360,7 @@ static GUIFont font;
 
 
 void setClipRect(const GUI_AABB &clip);
+void clearEventState();
 
 
 
@@ -264,7 +374,7 @@ bool mouseIn(int x, int y, int w, int h)
      * screen space so it must be transformed to local space first.
      */
     GUI_AABB local_clip_rect(clip_rect.min - w_offset, clip_rect.max - w_offset);
-    if(!local_clip_rect.containsPoint(mx, my))
+    if(clip_rect.isEmpty() || !local_clip_rect.containsPoint(mx, my))
         return false;
 
     return mx >= x && mx <= x+w && my >= y && my <= y+h;
@@ -275,39 +385,258 @@ void printClipRect()
     std::cout << "clip_rect: " << clip_rect.min[0] << ", " << clip_rect.min[1] << ", " << clip_rect.max[0] << ". " << clip_rect.max[1] << std::endl;
 }
 
-void genericHotActive(const std::string &id, float x, float y, float w, float h)
+/*--------------------------------------------------------------------------*
+ *
+ * Hit index. Every draw pass records the screen space rectangle (clipped to
+ * the current clip rect) and layer of each widget that hot tests. At the end
+ * of the pass they're binned into a uniform grid so a mouse move can find the
+ * hot widget without running the GUI's event pass.
+ *
+ *--------------------------------------------------------------------------*/
+#define HIT_CELL_SIZE 32.0f
+
+struct HitRect
 {
-    bool mouse_in = mouseIn(x, y, w, h);
+    GUIHash id;
+    GUI_AABB rect;
+    int layer;
+};
+
+/* rects recorded by the draw pass in progress */
+static std::vector<HitRect> hit_rects;
+
+/* the grid built from the last draw pass. each cell lists rects in call order */
+static std::vector<HitRect> hit_index_rects;
+static std::vector<int> hit_cell_start;
+static std::vector<int> hit_cell_items;
+static std::vector<int> hit_cell_fill;
+static GUI_AABB hit_bounds;
+static int hit_cols = 0, hit_rows = 0;
+
+/*
+ * The grid matches the GUI's layout until a response pass runs, since a
+ * response can move, open or close widgets.
+ */
+static bool hit_index_valid = false;
+
+/* set when the last mouse move found its hot widget using the grid */
+static bool hover_resolved = false;
+
+/* off until the host says every hot tested widget records itself when drawn */
+static bool hover_index = false;
+
+static void recordHitRect(const GUIID &id, float x, float y, float w, float h)
+{
+    GUI_AABB r = GUI_AABB::fromPositionSize(x + w_offset[0], y + w_offset[1], w, h);
 
-    if(mouse_in && layer >= hot_widget_layer)
+    r = clip_rect.intersection(r);
+
+    if(r.isEmpty())
+        return;
+
+    HitRect hr;
+    hr.id = id.hash;
+    hr.rect = r;
+    hr.layer = layer;
+    hit_rects.push_back(hr);
+}
+
+static void hitCellRange(const GUI_AABB &r, int *x0, int *y0, int *x1, int *y1)
+{
+    *x0 = cml::clamp(int((r.min[0] - hit_bounds.min[0]) / HIT_CELL_SIZE), 0, hit_cols-1);
+    *y0 = cml::clamp(int((r.min[1] - hit_bounds.min[1]) / HIT_CELL_SIZE), 0, hit_rows-1);
+    *x1 = cml::clamp(int((r.max[0] - hit_bounds.min[0]) / HIT_CELL_SIZE), 0, hit_cols-1);
+    *y1 = cml::clamp(int((r.max[1] - hit_bounds.min[1]) / HIT_CELL_SIZE), 0, hit_rows-1);
+}
+
+static void buildHitIndex()
+{
+    hit_index_rects.swap(hit_rects);
+    hit_rects.clear();
+
+    hit_bounds = screen_rect;
+    hit_cols = std::max(1, int(std::ceil(hit_bounds.getWidth() / HIT_CELL_SIZE)));
+    hit_rows = std::max(1, int(std::ceil(hit_bounds.getHeight() / HIT_CELL_SIZE)));
+
+    int num_cells = hit_cols * hit_rows;
+    hit_cell_start.assign(num_cells + 1, 0);
+
+    /* count rects per cell, turn the counts into offsets, then fill */
+    for(size_t i = 0; i < hit_index_rects.size(); i++)
+    {
+        int x0, y0, x1, y1;
+        hitCellRange(hit_index_rects[i].rect, &x0, &y0, &x1, &y1);
+
+        for(int cy = y0; cy <= y1; cy++)
+            for(int cx = x0; cx <= x1; cx++)
+                hit_cell_start[cy*hit_cols + cx + 1]++;
+    }
+
+    for(int c = 0; c < num_cells; c++)
+        hit_cell_start[c+1] += hit_cell_start[c];
+
+    hit_cell_items.resize(hit_cell_start[num_cells]);
+    hit_cell_fill.assign(hit_cell_start.begin(), hit_cell_start.end() - 1);
+
+    for(size_t i = 0; i < hit_index_rects.size(); i++)
+    {
+        int x0, y0, x1, y1;
+        hitCellRange(hit_index_rects[i].rect, &x0, &y0, &x1, &y1);
+
+        for(int cy = y0; cy <= y1; cy++)
+            for(int cx = x0; cx <= x1; cx++)
+                hit_cell_items[hit_cell_fill[cy*hit_cols + cx]++] = i;
+    }
+
+    hit_index_valid = true;
+}
+
+/*
+ * Same rule as the event pass: the last widget in call order on the highest
+ * layer under the mouse wins.
+ */
+static bool resolveHotFromIndex(float x, float y)
+{
+    if(!hit_index_valid || !hit_bounds.containsPoint(x, y))
+        return hit_index_valid;
+
+    int cx = cml::clamp(int((x - hit_bounds.min[0]) / HIT_CELL_SIZE), 0, hit_cols-1);
+    int cy = cml::clamp(int((y - hit_bounds.min[1]) / HIT_CELL_SIZE), 0, hit_rows-1);
+    int cell = cy*hit_cols + cx;
+
+    for(int i = hit_cell_start[cell]; i < hit_cell_start[cell+1]; i++)
+    {
+        const HitRect &hr = hit_index_rects[hit_cell_items[i]];
+
+        if(hr.rect.containsPoint(x, y) && hr.layer >= hot_widget_layer)
+        {
+            hot_widget = hr.id;
+            hot_widget_layer = hr.layer;
+            is_mouse_in = true;
+        }
+    }
+
+    return true;
+}
+
+void nameWidget(const GUIID &id)
+{
+    if(debug_names_enabled && id.name != NULL && debug_names.find(id.hash) == debug_names.end())
+        debug_names[id.hash] = id.name;
+}
+
+/*
+ * Stack of id scopes. Composite widgets push their own id and name their
+ * children relative to it with GUI_ScopedID(), which continues hashing from
+ * the scope's hash. GUI_ScopedID("_inc") inside a scope pushed with "bar"
+ * gives the same id as "bar/_inc" without building the string.
+ */
+static std::vector<GUIID> id_stack;
+
+static GUIID scopedID(const char *suffix, size_t len)
+{
+    GUIHash parent = id_stack.empty() ? GUI_HASH_OFFSET : id_stack.back().hash;
+    GUIID child(GUI_HashBytes(suffix, len, GUI_HashBytes("/", 1, parent)), NULL);
+
+    if(debug_names_enabled && debug_names.find(child.hash) == debug_names.end())
     {
-        hot_widget = id;
-        hot_widget_layer = layer;
-        is_mouse_in = true;
+        std::string name;
+
+        if(!id_stack.empty())
+        {
+            std::map<GUIHash, std::string>::iterator it = debug_names.find(parent);
+            if(it != debug_names.end())
+                name = it->second;
+        }
+
+        debug_names[child.hash] = name + "/" + std::string(suffix, len);
     }
 
-    if(hot_widget == id && mouse.left_just_pressed)
-        active_widget = id;
+    return child;
+}
+
+void GUI_PushID(GUIID id)
+{
+    nameWidget(id);
+    id_stack.push_back(id);
+}
+
+void GUI_PopID()
+{
+    if(!id_stack.empty())
+        id_stack.pop_back();
+    else
+        std::cout << "id_stack empty\n";
+}
+
+GUIID GUI_ScopedID(const char *suffix)
+{
+    return scopedID(suffix, strlen(suffix));
+}
+
+/*
+ * Same as GUI_ScopedID("_<index>").
+ */
+GUIID GUI_ScopedID(int index)
+{
+    char buf[16];
+    char *p = buf + sizeof(buf);
+    unsigned int n = index;
+
+    do
+    {
+        *--p = '0' + n % 10;
+        n /= 10;
+    } while(n != 0);
+
+    *--p = '_';
+
+    return scopedID(p, buf + sizeof(buf) - p);
 }
 
-void hotTest(const std::string &id, float x, float y, float w, float h)
+/*
+ * Declares the interactive area of a widget. Widgets call this in every pass:
+ * the event pass uses it to find the hot widget and the draw pass records it
+ * in the hit index.
+ */
+void hotTest(GUIID id, float x, float y, float w, float h)
 {
+    if(isDrawPass())
+        recordHitRect(id, x, y, w, h);
+
+    if(!isEventPass())
+        return;
+
     bool mouse_in = mouseIn(x, y, w, h);
 
-    if(mouse_in && layer >= hot_widget_layer)
+    /* a single pass finds next frame's hot widget and keeps this one */
+    GUIHash &hot      = single_pass_mode ? next_hot_widget : hot_widget;
+    int &hot_layer    = single_pass_mode ? next_hot_widget_layer : hot_widget_layer;
+    bool &any_mouse_in = single_pass_mode ? next_is_mouse_in : is_mouse_in;
+
+    if(mouse_in && layer >= hot_layer)
     {
-        hot_widget = id;
-        hot_widget_layer = layer;
-        is_mouse_in = true;
+        hot = id.hash;
+        hot_layer = layer;
+        any_mouse_in = true;
+        nameWidget(id);
     }
 }
 
+void genericHotActive(GUIID id, float x, float y, float w, float h)
+{
+    hotTest(id, x, y, w, h);
+
+    if(isEventPass() && hot_widget == id.hash && mouse.left_just_pressed)
+        active_widget = id.hash;
+}
+
 
 
 
 void GUI_Init()
 {
-    clip_stack = std::stack<GUI_AABB>();
+    clip_stack = std::stack<ClipEntry>();
     clip_rect = GUI_AABB(-1000000.0f, -1000000.0f, 1000000.0f, 1000000.0f);
     screen_rect = GUI_AABB(0.0f, 0.0f, 640.0f, 480.0f);
 
@@ -326,8 +655,8 @@ void GUI_Init()
     keyboard.key_pressed = sf::Key::Count;
     keyboard.control = keyboard.alt = keyboard.shift = false;
 
-    hot_widget = "";
-    active_widget = "";
+    hot_widget = 0;
+    active_widget = 0;
     active_widget_layer = 0;
     hot_widget_layer = 0;
     layer = 0;
@@ -350,19 +679,60 @@ void GUI_BeginPass(int p)
 
     if(pass == GUI_PASS_EVENT)
     {
+        single_pass_mode = false;
         is_mouse_in = false;
     }
-    else if(pass == GUI_PASS_DRAW)
+    else if(pass == GUI_PASS_RESPONSE)
+    {
+        hit_index_valid = false;
+    }
+    else if(pass == GUI_PASS_SINGLE)
+    {
+        single_pass_mode = true;
+        hit_index_valid = false;
+        next_hot_widget = 0;
+        next_hot_widget_layer = 0;
+        next_is_mouse_in = false;
+    }
+
+    if(isDrawPass())
     {
         GUI_DrawBegin();
+        hit_rects.clear();
+
+        /* requests made while drawing carry over to the next frame */
+        redraw_requested = false;
     }
 }
 
 void GUI_EndPass()
 {
-    if(pass == GUI_PASS_DRAW)
+    if(isDrawPass())
+    {
+        last_frame_changed = GUI_DrawEnd();
+        input_since_draw = false;
+
+        redraw_stats.frames++;
+        if(!last_frame_changed)
+            redraw_stats.unchanged++;
+
+        GUI_StateEndFrame();
+
+        if(!single_pass_mode && hover_index)
+            buildHitIndex();
+    }
+
+    if(pass == GUI_PASS_SINGLE)
     {
-        GUI_DrawEnd();
+        /*
+         * the hot widget found this frame is what the next frame responds
+         * to. Input has been consumed so clear the per-event state.
+         */
+        hot_widget = next_hot_widget;
+        hot_widget_layer = next_hot_widget_layer;
+        is_mouse_in = next_is_mouse_in;
+        clearEventState();
+        frame_input = 0;
     }
 
     pass = GUI_PASS_NONE;
@@ -372,7 +742,8 @@ void GUI_ScreenBounds(float x, float y, float w, float h)
 {
     screen_rect.min.set(x, y);
     screen_rect.max.set(cml::clamp(w, 0.0f, 1000000.0f), cml::clamp(h, 0.0f, 1000000.0f));
-    setClipRect(clip_rect);
+    redraw_requested = true;
+    setClipRect(clip_stack.top().rect);
 }
 
 void setClipRect(const GUI_AABB &clip)
@@ -380,7 +751,7 @@ void setClipRect(const GUI_AABB &clip)
     clip_rect = clip.intersection(screen_rect);
     //std::cout << "clip_rect: " << clip_rect.min << " " << clip_rect.max << std::endl;
 
-    if(pass == GUI_PASS_DRAW)
+    if(isDrawPass())
     {
         float x = clip_rect.min[0];
         float w = clip_rect.max[0] - clip_rect.min[0];
@@ -398,8 +769,15 @@ void GUI_PushClipRect(const GUI_AABB &clip)
      * the actual clipping rectangle needs to be recomputed if the screen
      * size changes.
      */
-    clip_stack.push(clip);
-    setClipRect(clip);
+    ClipEntry e;
+    e.rect = clip;
+    e.layer = layer;
+
+    if(!clip_stack.empty() && clip_stack.top().layer >= layer)
+        e.rect = clip_stack.top().rect.intersection(clip);
+
+    clip_stack.push(e);
+    setClipRect(e.rect);
 }
 
 void GUI_PopClipRect()
@@ -407,7 +785,7 @@ void GUI_PopClipRect()
     if(clip_stack.size() > 1)
     {
         clip_stack.pop();
-        setClipRect(clip_stack.top());
+        setClipRect(clip_stack.top().rect);
     }
     else
         std::cout << "clip_stack empty\n";
@@ -435,7 +813,19 @@ const GUIFont& GUI_GetFont()
     return font;
 }
 
-void GUI_BeginGroup(float x, float y, float w, float h)
+bool GUI_IsVisible(float x, float y, float w, float h)
+{
+    GUI_AABB r = GUI_AABB::fromPositionSize(w_offset[0] + x, w_offset[1] + y, w, h);
+    return !clip_rect.intersection(r).isEmpty();
+}
+
+/*
+ * Returns false if nothing in the group can be seen. In any pass that takes
+ * input, single pass included, a hidden group still counts as visible while a
+ * widget is active, since the active widget could be inside it and needs to
+ * see the button go up.
+ */
+bool GUI_BeginGroup(float x, float y, float w, float h)
 {
     float wx = w_offset[0];
     float wy = w_offset[1];
@@ -443,6 +833,8 @@ void GUI_BeginGroup(float x, float y, float w, float h)
     GUI_PushClipRect(GUI_AABB::fromPositionSize(wx + x, wy + y, w, h));
     GUI_PushTranslation();
     GUI_Translate(x, y);
+
+    return !clip_rect.isEmpty() || (pass != GUI_PASS_DRAW && active_widget != 0);
 }
 
 void GUI_EndGroup()
@@ -462,14 +854,14 @@ void GUI_Translate(float x, float y)
     mouse.x -= x;
     mouse.y -= y;
 
-    if(pass == GUI_PASS_DRAW) GUI_DrawTranslate(x, y);
+    if(isDrawPass()) GUI_DrawTranslate(x, y);
 }
 
 void GUI_PushTranslation()
 {
     w_offset_stack.push(w_offset);
     mouse_pos_stack.push(cml::vector2f(mouse.x, mouse.y));
-    if(pass == GUI_PASS_DRAW) GUI_DrawPushTranslation();
+    if(isDrawPass()) GUI_DrawPushTranslation();
 }
 
 void GUI_PopTranslation()
@@ -483,7 +875,7 @@ void GUI_PopTranslation()
     mouse.x = mpos[0];
     mouse.y = mpos[1];
 
-    if(pass == GUI_PASS_DRAW) GUI_DrawPopTranslation();
+    if(isDrawPass()) GUI_DrawPopTranslation();
 }
 
 
@@ -510,11 +902,8 @@ void GUI_PopButtonMode()
  * variables that only last for the duration of one event (e.g. button just
  * pressed, mouse dx dy).
  */
-void setEventState()
+void clearEventState()
 {
-    hot_widget = "";
-    hot_widget_layer = 0;
-
     GUIMouseState &m = mouse;
     m.wheel_delta = 0;
     m.left_just_pressed = m.right_just_pressed = false;
@@ -525,6 +914,24 @@ void setEventState()
     keyboard.is_key_typed = false;
     keyboard.key_typed = 0;
     keyboard.key_pressed = sf::Key::Count;
+    keyboard.text.clear();
+}
+
+/*
+ * In single pass mode events accumulate until the pass consumes them, and the
+ * hot widget found by the previous frame is kept.
+ */
+void setEventState()
+{
+    input_since_draw = true;
+
+    if(single_pass_mode)
+        return;
+
+    hot_widget = 0;
+    hot_widget_layer = 0;
+
+    clearEventState();
 }
 
 void GUI_MouseButton(sf::Mouse::Button button, bool down)
@@ -533,9 +940,6 @@ void GUI_MouseButton(sf::Mouse::Button button, bool down)
 
     GUIMouseState &m = mouse;
 
-    m.left_just_pressed = m.right_just_pressed = false;
-    m.left_just_released = m.right_just_released = false;
-
     if(button == sf::Mouse::Left)
     {
         if(down && !m.left_down)
@@ -572,21 +976,43 @@ void GUI_MouseMove(float x, float y)
 {
     setEventState();
 
-    mouse.dx = x - mouse.x;
-    mouse.dy = y - mouse.y;
+    mouse.dx += x - mouse.x;
+    mouse.dy += y - mouse.y;
     mouse.x = x;
     mouse.y = y;
-    hot_widget = "";
 
     if(mouse.left_down || mouse.right_down)
         mouse.dragged = true;
+
+    /*
+     * a plain move only changes the hot widget, which the hit index can find
+     * without an event pass. Drags still need the widgets to see the move.
+     */
+    hover_resolved = false;
+
+    if(hover_index && !single_pass_mode && !mouse.dragged)
+    {
+        is_mouse_in = false;
+        hover_resolved = resolveHotFromIndex(x, y);
+    }
+}
+
+void GUI_HoverIndex(bool enable)
+{
+    hover_index = enable;
+    hit_index_valid = false;
+}
+
+bool GUI_HoverResolved()
+{
+    return hover_resolved;
 }
 
 void GUI_MouseWheel(int delta)
 {
     setEventState();
 
-    mouse.wheel_delta = delta;
+    mouse.wheel_delta += delta;
 }
 
 void GUI_KeyPressed(sf::Key::Code key, bool control, bool alt, bool shift)
@@ -607,114 +1033,422 @@ void GUI_KeyTyped(int key)
     keyboard.key_typed = key;
 }
 
+void GUI_TextInput(const char *text, size_t len)
+{
+    setEventState();
 
+    keyboard.text.append(text, len);
+}
 
-void GUI_SetLayer(int new_layer)
+static int encodeUTF8(int c, char *out)
 {
-    layer = new_layer;
-    if(pass == GUI_PASS_DRAW) GUI_DrawSetLayer(new_layer);
+    if(c < 0x80)    { out[0] = c; return 1; }
+    if(c < 0x800)   { out[0] = 0xc0 | (c >> 6);  out[1] = 0x80 | (c & 0x3f); return 2; }
+    if(c < 0x10000) { out[0] = 0xe0 | (c >> 12); out[1] = 0x80 | ((c >> 6) & 0x3f); out[2] = 0x80 | (c & 0x3f); return 3; }
+
+    out[0] = 0xf0 | (c >> 18);
+    out[1] = 0x80 | ((c >> 12) & 0x3f);
+    out[2] = 0x80 | ((c >> 6) & 0x3f);
+    out[3] = 0x80 | (c & 0x3f);
+    return 4;
 }
 
-void GUI_PushLayer()
+
+
+enum
 {
-    layer_stack.push(layer);
+    INPUT_MOUSE_BUTTON,
+    INPUT_MOUSE_MOVE,
+    INPUT_MOUSE_WHEEL,
+    INPUT_KEY_PRESSED,
+    INPUT_KEY_TYPED,
+    INPUT_TEXT,
+};
+
+struct GUIInputEvent
+{
+    int type;
+    float x, y;
+    int value;
+    size_t text, text_len;  /* run in input_text */
+    sf::Mouse::Button button;
+    sf::Key::Code key;
+    bool down, control, alt, shift;
+};
+
+/*
+ * Events waiting for GUI_ProcessInput(). input_head is the first unprocessed
+ * event; the vector is only cleared once everything has been processed so its
+ * storage gets reused.
+ */
+static std::vector<GUIInputEvent> input_queue;
+static size_t input_head = 0;
+
+/* text of queued INPUT_TEXT events, cleared along with input_queue */
+static std::string input_text;
+static GUIInputStats input_stats;
+
+static GUIInputEvent& queueEvent(int type)
+{
+    GUIInputEvent e;
+    e.type = type;
+    e.x = e.y = 0.0f;
+    e.value = 0;
+    e.text = e.text_len = 0;
+    e.button = sf::Mouse::Left;
+    e.key = sf::Key::Count;
+    e.down = e.control = e.alt = e.shift = false;
+
+    input_queue.push_back(e);
+    input_stats.queued++;
+    return input_queue.back();
 }
 
-void GUI_PopLayer()
+static GUIInputEvent* lastQueued(int type)
 {
-    GUI_SetLayer(layer_stack.top());
-    layer_stack.pop();
+    if(input_queue.size() > input_head && input_queue.back().type == type)
+        return &input_queue.back();
+
+    return NULL;
 }
 
-void GUI_Label(const std::string &id, int x, int y, int w, int h, const std::string &str)
+void GUI_QueueMouseButton(sf::Mouse::Button button, bool down)
 {
-    if(pass == GUI_PASS_DRAW)
-    {
-        GUI_DrawLabel(x, y, w, h, str);
-    }
+    GUIInputEvent &e = queueEvent(INPUT_MOUSE_BUTTON);
+    e.button = button;
+    e.down = down;
 }
 
-bool GUI_Button(const std::string &id, int x, int y, int w, int h, const std::string &str)
+void GUI_QueueMouseMove(float x, float y)
 {
-    bool event = false;
+    GUIInputEvent *last = lastQueued(INPUT_MOUSE_MOVE);
 
-    if(pass == GUI_PASS_EVENT)
+    if(last != NULL)
     {
-        genericHotActive(id, x, y, w, h);
-    }
-    else if(pass == GUI_PASS_RESPONSE)
-    {
-        if(button_mode == GUI_ACTIVATE_ON_UP && mouse.left_just_released)
-        {
-            if(active_widget == id && hot_widget == id)
-            {
-                event = true;
-                active_widget = "";
-            }
-            else if(active_widget == id)
-            {
-                active_widget = "";
-            }
-        }
-        else if(button_mode == GUI_ACTIVATE_ON_DOWN && mouse.left_just_pressed)
-        {
-            if(hot_widget == id)
-            {
-                event = true;
-                active_widget = "";
-            }
-        }
-    }
-    else if(pass == GUI_PASS_DRAW)
-    {
-        GUI_DrawButton(x, y, w, h, hot_widget == id, active_widget == id, str);
+        last->x = x;
+        last->y = y;
+        input_stats.queued++;
+        input_stats.coalesced++;
+        return;
     }
 
-
-    return event;
+    GUIInputEvent &e = queueEvent(INPUT_MOUSE_MOVE);
+    e.x = x;
+    e.y = y;
 }
 
-bool GUI_ToggleButton(const std::string &id, int x, int y, int w, int h, const std::string &str, bool *value)
+void GUI_QueueMouseWheel(int delta)
 {
-    if(pass == GUI_PASS_DRAW)
+    GUIInputEvent *last = lastQueued(INPUT_MOUSE_WHEEL);
+
+    if(last != NULL)
     {
-        GUI_DrawButton(x, y, w, h, hot_widget == id, *value, str);
-        return false;
+        last->value += delta;
+        input_stats.queued++;
+        input_stats.coalesced++;
+        return;
     }
 
-    bool evt = GUI_Button(id, x, y, w, h, str);
-
-    if(evt)
-        *value = !*value;
-
-    return evt;
+    GUIInputEvent &e = queueEvent(INPUT_MOUSE_WHEEL);
+    e.value = delta;
 }
 
-bool GUI_Checkbox(const std::string &id, float x, float y, float w, float h, bool *value)
+/* keys that only type a character when pressed on their own */
+static bool isTextKey(sf::Key::Code key)
 {
-    bool evt = false;
+    return (sf::Key::A <= key && key <= sf::Key::Z) ||
+           (sf::Key::Num0 <= key && key <= sf::Key::Num9) ||
+           (sf::Key::LBracket <= key && key <= sf::Key::Space) ||
+           (sf::Key::Add <= key && key <= sf::Key::Divide) ||
+           (sf::Key::Numpad0 <= key && key <= sf::Key::Numpad9);
+}
 
-    if(pass != GUI_PASS_DRAW)
-        evt = GUI_ToggleButton(id, x, y, w, h, "", value);
-    else
+/* modifiers of the last key press queued, kept for the text it types */
+static bool queued_control = false, queued_alt = false, queued_shift = false;
+
+/*
+ * SFML sends a key press before the text it types. Presses of printable keys
+ * without control or alt aren't queued, since nothing acts on them and they
+ * would split a burst of typing into one text run per key. Their modifiers
+ * still reach the widgets with the text.
+ */
+void GUI_QueueKeyPressed(sf::Key::Code key, bool control, bool alt, bool shift)
+{
+    queued_control = control;
+    queued_alt = alt;
+    queued_shift = shift;
+
+    if(!control && !alt && isTextKey(key))
+        return;
+
+    GUIInputEvent &e = queueEvent(INPUT_KEY_PRESSED);
+    e.key = key;
+    e.control = control;
+    e.alt = alt;
+    e.shift = shift;
+}
+
+/*
+ * Printable characters are queued as text so a burst of typing is merged
+ * into one run.
+ */
+void GUI_QueueKeyTyped(int key)
+{
+    if(key >= ' ' && key != 0x7f)
+    {
+        char buf[4];
+        GUI_QueueTextInput(buf, encodeUTF8(key, buf));
+        return;
+    }
+
+    GUIInputEvent &e = queueEvent(INPUT_KEY_TYPED);
+    e.value = key;
+}
+
+void GUI_QueueTextInput(const char *text, size_t len)
+{
+    GUIInputEvent *last = lastQueued(INPUT_TEXT);
+
+    if(last != NULL)
+    {
+        /* the last queued run always ends input_text */
+        input_text.append(text, len);
+        last->text_len += len;
+        last->control = queued_control;
+        last->alt = queued_alt;
+        last->shift = queued_shift;
+        input_stats.queued++;
+        input_stats.coalesced++;
+        return;
+    }
+
+    GUIInputEvent &e = queueEvent(INPUT_TEXT);
+    e.text = input_text.size();
+    e.text_len = len;
+    e.control = queued_control;
+    e.alt = queued_alt;
+    e.shift = queued_shift;
+    input_text.append(text, len);
+}
+
+static void applyInput(const GUIInputEvent &e)
+{
+    switch(e.type)
+    {
+        case INPUT_MOUSE_BUTTON: GUI_MouseButton(e.button, e.down); break;
+        case INPUT_MOUSE_MOVE:   GUI_MouseMove(e.x, e.y); break;
+        case INPUT_MOUSE_WHEEL:  GUI_MouseWheel(e.value); break;
+        case INPUT_KEY_PRESSED:  GUI_KeyPressed(e.key, e.control, e.alt, e.shift); break;
+        case INPUT_KEY_TYPED:    GUI_KeyTyped(e.value); break;
+        case INPUT_TEXT:
+        {
+            /* a run carries the modifiers of its last key, whose press wasn't queued */
+            GUI_TextInput(input_text.data() + e.text, e.text_len);
+            keyboard.control = e.control;
+            keyboard.alt = e.alt;
+            keyboard.shift = e.shift;
+            break;
+        }
+        default: break;
+    }
+}
+
+/*
+ * In single pass mode no passes are run here. Events are applied to the input
+ * state for the next GUI_PASS_SINGLE until one would overwrite a button or key
+ * that hasn't been consumed yet; moves and wheel deltas always accumulate.
+ */
+int GUI_ProcessInput(void (*do_pass)(int pass), int max_events)
+{
+    int processed = 0;
+
+    while(input_head < input_queue.size() && processed < max_events)
+    {
+        /* copied since do_pass may queue more input */
+        GUIInputEvent e = input_queue[input_head];
+
+        if(single_pass_mode)
+        {
+            int bit = 1 << e.type;
+            bool accumulates = e.type == INPUT_MOUSE_MOVE || e.type == INPUT_MOUSE_WHEEL;
+
+            if(!accumulates && (frame_input & bit))
+                break;
+
+            frame_input |= bit;
+            input_head++;
+            applyInput(e);
+        }
+        else
+        {
+            input_head++;
+            applyInput(e);
+
+            if(!(e.type == INPUT_MOUSE_MOVE && hover_resolved))
+                do_pass(GUI_PASS_EVENT);
+            do_pass(GUI_PASS_RESPONSE);
+        }
+
+        processed++;
+    }
+
+    if(input_head == input_queue.size())
+    {
+        input_queue.clear();
+        input_text.clear();
+        input_head = 0;
+    }
+
+    input_stats.processed += processed;
+    return processed;
+}
+
+GUIInputStats GUI_GetInputStats()
+{
+    return input_stats;
+}
+
+/*
+ * Counts a skipped frame when it returns false, so hosts should call it once
+ * per frame.
+ */
+bool GUI_NeedsRedraw()
+{
+    bool needed = input_since_draw || redraw_requested || last_frame_changed ||
+                  input_head < input_queue.size();
+
+    if(!needed)
+        redraw_stats.skipped++;
+
+    return needed;
+}
+
+void GUI_RequestRedraw()
+{
+    redraw_requested = true;
+}
+
+GUIRedrawStats GUI_GetRedrawStats()
+{
+    return redraw_stats;
+}
+
+
+
+void GUI_SetLayer(int new_layer)
+{
+    layer = new_layer;
+    if(isDrawPass()) GUI_DrawSetLayer(new_layer);
+}
+
+void GUI_PushLayer()
+{
+    layer_stack.push(layer);
+}
+
+void GUI_PopLayer()
+{
+    GUI_SetLayer(layer_stack.top());
+    layer_stack.pop();
+}
+
+void GUI_Label(GUIID id, int x, int y, int w, int h, const std::string &str)
+{
+    if(isDrawPass())
+    {
+        GUI_DrawLabel(x, y, w, h, str);
+    }
+}
+
+/*
+ * Event and response handling shared by all button like widgets.
+ */
+static bool buttonBehavior(GUIID id, float x, float y, float w, float h)
+{
+    bool event = false;
+
+    genericHotActive(id, x, y, w, h);
+
+    if(isResponsePass())
+    {
+        if(button_mode == GUI_ACTIVATE_ON_UP && mouse.left_just_released)
+        {
+            if(active_widget == id.hash && hot_widget == id.hash)
+            {
+                event = true;
+                active_widget = 0;
+            }
+            else if(active_widget == id.hash)
+            {
+                active_widget = 0;
+            }
+        }
+        else if(button_mode == GUI_ACTIVATE_ON_DOWN && mouse.left_just_pressed)
+        {
+            if(hot_widget == id.hash)
+            {
+                event = true;
+                active_widget = 0;
+            }
+        }
+    }
+
+    return event;
+}
+
+static bool toggleBehavior(GUIID id, float x, float y, float w, float h, bool *value)
+{
+    bool evt = buttonBehavior(id, x, y, w, h);
+
+    if(evt)
+        *value = !*value;
+
+    return evt;
+}
+
+bool GUI_Button(GUIID id, int x, int y, int w, int h, const std::string &str)
+{
+    bool event = buttonBehavior(id, x, y, w, h);
+
+    if(isDrawPass())
+    {
+        GUI_DrawButton(x, y, w, h, hot_widget == id.hash, active_widget == id.hash, str);
+    }
+
+    return event;
+}
+
+bool GUI_ToggleButton(GUIID id, int x, int y, int w, int h, const std::string &str, bool *value)
+{
+    bool evt = toggleBehavior(id, x, y, w, h, value);
+
+    if(isDrawPass())
+        GUI_DrawButton(x, y, w, h, hot_widget == id.hash, *value, str);
+
+    return evt;
+}
+
+bool GUI_Checkbox(GUIID id, float x, float y, float w, float h, bool *value)
+{
+    bool evt = toggleBehavior(id, x, y, w, h, value);
+
+    if(isDrawPass())
         GUI_DrawCheckbox(x, y, w, h, *value);
 
     return evt;
 }
 
-bool GUI_CheckboxLabelled(const std::string id, float x, float y, float w, float h, const std::string &label, bool *value)
+bool GUI_CheckboxLabelled(GUIID id, float x, float y, float w, float h, const std::string &label, bool *value)
 {
-    bool evt = false;
+    bool evt = toggleBehavior(id, x, y, w, h, value);
 
-    if(pass != GUI_PASS_DRAW)
-        evt = GUI_ToggleButton(id, x, y, w, h, "", value);
-    else
-        GUI_DrawCheckboxLabelled(x, y, w, h, x, y, h, h, id == hot_widget, label, *value);
+    if(isDrawPass())
+        GUI_DrawCheckboxLabelled(x, y, w, h, x, y, h, h, id.hash == hot_widget, label, *value);
 
     return evt;
 }
 
-bool GUI_Slider(const std::string &id, float x, float y, float w, float h, int type, int min, int max, int page_size, int *value)
+bool GUI_Slider(GUIID id, float x, float y, float w, float h, int type, int min, int max, int page_size, int *value)
 {
     bool evt = false;
 
@@ -743,18 +1477,16 @@ bool GUI_Slider(const std::string &id, float x, float y, float w, float h, int t
     }
 
 
-    if(pass == GUI_PASS_DRAW)
+    if(isDrawPass())
     {
         GUI_DrawSlider(x, y, w, h, thumb_x, thumb_y, thumb_w, thumb_h); 
     }
 
-    if(pass == GUI_PASS_EVENT)
-    {
-        genericHotActive(id, x, y, w, h);
-    }
-    else if(pass == GUI_PASS_RESPONSE)
+    genericHotActive(id, x, y, w, h);
+
+    if(isResponsePass())
     {
-        if(active_widget == id && mouse.left_down && mouse.dragged)
+        if(active_widget == id.hash && mouse.left_down && mouse.dragged)
         {
             float rel;
 
@@ -776,7 +1508,13 @@ bool GUI_Slider(const std::string &id, float x, float y, float w, float h, int t
     return evt;
 }
 
-bool GUI_Scrollbar(const std::string &id, float x, float y, float w, float h, int type, int min, int max, int page_size, int *value)
+bool GUI_Scrollbar(GUIID id, float x, float y, float w, float h, int type, int min, int max, int page_size, int *value)
+{
+    return GUI_Scrollbar(id, x, y, w, h, type, min, max, page_size, value, 1);
+}
+
+/* the arrow buttons move value by step */
+bool GUI_Scrollbar(GUIID id, float x, float y, float w, float h, int type, int min, int max, int page_size, int *value, int step)
 {
     int old_value = *value;
     int button_mode = GUI_DrawGetButtonMode();
@@ -784,40 +1522,44 @@ bool GUI_Scrollbar(const std::string &id, float x, float y, float w, float h, in
 
     GUI_PushButtonMode();
     GUI_ButtonMode(GUI_ACTIVATE_ON_DOWN);
-    GUI_BeginGroup(x, y, w, h);
+    GUI_PushID(id);
+    if(GUI_BeginGroup(x, y, w, h))
+    {
         if(type == GUI_HORIZONTAL)
         {
             float b_size = h;
-            GUI_Slider(id + "/_s", b_size, 0.0f, w-b_size-b_size, h, type, min, max, page_size, value);
+            GUI_Slider(GUI_ScopedID("_s"), b_size, 0.0f, w-b_size-b_size, h, type, min, max, page_size, value);
             
-            if(GUI_Button(id + "/_dec", 0.0f, 0.0f, w, b_size, "l"))
-                *value = cml::clamp(*value - 1, min, max-page_size);
-            if(GUI_Button(id + "/_inc", w-b_size, 0.0f, w, b_size, "r"))
-                *value = cml::clamp(*value + 1, min, max-page_size);
+            if(GUI_Button(GUI_ScopedID("_dec"), 0.0f, 0.0f, w, b_size, "l"))
+                *value = cml::clamp(*value - step, min, max-page_size);
+            if(GUI_Button(GUI_ScopedID("_inc"), w-b_size, 0.0f, w, b_size, "r"))
+                *value = cml::clamp(*value + step, min, max-page_size);
         }
         else
         {
             float b_size = w;
-            GUI_Slider(id + "/_s", 0.0f, b_size, w, h-b_size-b_size, type, min, max, page_size, value);
+            GUI_Slider(GUI_ScopedID("_s"), 0.0f, b_size, w, h-b_size-b_size, type, min, max, page_size, value);
             
-            if(GUI_Button(id + "/_dec", 0.0f, 0.0f, w, b_size, "u"))
-                *value = cml::clamp(*value - 1, min, max-page_size);
-            if(GUI_Button(id + "/_inc", 0.0f, h-b_size, w, b_size, "d"))
-                *value = cml::clamp(*value + 1, min, max-page_size);
+            if(GUI_Button(GUI_ScopedID("_dec"), 0.0f, 0.0f, w, b_size, "u"))
+                *value = cml::clamp(*value - step, min, max-page_size);
+            if(GUI_Button(GUI_ScopedID("_inc"), 0.0f, h-b_size, w, b_size, "d"))
+                *value = cml::clamp(*value + step, min, max-page_size);
         }
+    }
     GUI_EndGroup();
+    GUI_PopID();
     GUI_PopButtonMode();
     GUI_DrawSetButtonMode(button_mode);
 
     return old_value != *value;
 }
 
-void GUI_BeginFrame(float x, float y, float w, float h, float padding_x, float padding_y)
+bool GUI_BeginFrame(float x, float y, float w, float h, float padding_x, float padding_y)
 {
-    if(pass == GUI_PASS_DRAW)
+    if(isDrawPass() && GUI_IsVisible(x, y, w, h))
         GUI_DrawFrame(x, y, w, h, padding_x, padding_y);
 
-    GUI_BeginGroup(x+padding_x, y+padding_y, w-padding_x*2.0f, h-padding_y*2.0f);
+    return GUI_BeginGroup(x+padding_x, y+padding_y, w-padding_x*2.0f, h-padding_y*2.0f);
 }
 
 void GUI_EndFrame()
@@ -827,7 +1569,7 @@ void GUI_EndFrame()
 
 void GUI_Frame(float x, float y, float w, float h)
 {
-    if(pass == GUI_PASS_DRAW)
+    if(isDrawPass())
     {
         //FIXME get rid of this
         window.Draw(sf::Shape::Line(x,   y,   x+w, y,   2.0f, sf::Color::White));
@@ -837,177 +1579,577 @@ void GUI_Frame(float x, float y, float w, float h)
     }
 }
 
-bool GUI_Listbox(const std::string &id, float x, float y, float w, float h, const std::vector<std::string> &data, int data_offset, int *choice)
+/* row provider over a std::vector<std::string> */
+static const char *vectorRow(int row, void *user)
+{
+    return (*(const std::vector<std::string>*)user)[row].c_str();
+}
+
+/* row provider over a GUIStringTable */
+static const char *tableRow(int row, void *user)
+{
+    return (*(const GUIStringTable*)user)[row];
+}
+
+bool GUI_Listbox(GUIID id, float x, float y, float w, float h, const GUIStringTable &data, int data_offset, int *choice)
+{
+    return GUI_Listbox(id, x, y, w, h, data.size(), tableRow, (void*)&data, data_offset, choice);
+}
+
+bool GUI_Listbox(GUIID id, float x, float y, float w, float h, const std::vector<std::string> &data, int data_offset, int *choice)
+{
+    return GUI_Listbox(id, x, y, w, h, data.size(), vectorRow, (void*)&data, data_offset, choice);
+}
+
+bool GUI_Listbox(GUIID id, float x, float y, float w, float h, int count, GUIRowText text, void *user, int data_offset, int *choice)
 {
     bool event = false;
 
-    if(pass == GUI_PASS_EVENT)
-    {
-        genericHotActive(id, x, y, w, h);
-    }
-    else if(pass == GUI_PASS_RESPONSE)
+    genericHotActive(id, x, y, w, h);
+
+    if(isResponsePass())
     {
-        if(hot_widget == id && mouse.left_just_pressed)
+        if(hot_widget == id.hash && mouse.left_just_pressed)
         {
             int item = (mouse.y - y) / listbox_item_height;
-            item = cml::clamp(item + data_offset, 0, (int)data.size()-1);
+            item = cml::clamp(item + data_offset, 0, count-1);
 
-            if(0 <= item && item < data.size() && item != *choice)
+            if(0 <= item && item < count && item != *choice)
             {
                 *choice = item;
                 event = true;
             }
         }
     }
-    else if(pass == GUI_PASS_DRAW)
+
+    if(isDrawPass())
     {
-        GUI_BeginGroup(x, y, w, h);
-        GUI_DrawListbox(0.0f, 0.0f, w, h, listbox_item_height, data, data_offset, *choice);
+        if(GUI_BeginGroup(x, y, w, h))
+            GUI_DrawListbox(0.0f, 0.0f, w, h, listbox_item_height, count, text, user, data_offset, *choice);
         GUI_EndGroup();
     }
 
     return event;
 }
 
-bool GUI_ScrolledListbox(const std::string &id, float x, float y, float w, float h, const std::vector<std::string> &data, int *choice, cml::vector2i *scroll)
+/*--------------------------------------------------------------------------*
+ *
+ * Type-ahead. Typing into a focused list jumps to the first row that starts
+ * with what has been typed, ignoring ASCII case. A pause of more than a
+ * second starts a new prefix. The first key builds an index of the rows
+ * sorted by their case folded text, and a min tree over that order gives the
+ * lowest row in the run of keys that match, so every key after that is
+ * O(log n). The index is rebuilt when the row count, provider or data
+ * generation changes. Lists without a generation (0) can't say when they
+ * change, so they're also rebuilt when the row found no longer starts with
+ * the prefix, and on a miss unless the index was already built since the
+ * prefix was started.
+ *
+ *--------------------------------------------------------------------------*/
+#define TYPEAHEAD_TIMEOUT 1.0f
+
+static sf::Clock typeahead_clock;
+
+struct TypeAheadState
+{
+    GUIStringTable keys;        /* case folded text of each row */
+    std::vector<int> order;     /* rows sorted by key */
+    std::vector<int> min_row;   /* min tree over order, leaves at count */
+    int count;
+    GUIRowText text;
+    void *user;
+    unsigned int generation;
+    bool built;
+    bool fresh;                 /* built since prefix was started */
+
+    std::string prefix;         /* case folded */
+    float last_key;
+
+    TypeAheadState() : count(0), text(NULL), user(NULL), generation(0), built(false), fresh(false), last_key(0.0f) {}
+};
+
+struct TypeAheadLess
+{
+    const GUIStringTable *keys;
+
+    bool operator()(int a, int b) const
+    {
+        return strcmp((*keys)[a], (*keys)[b]) < 0;
+    }
+};
+
+/* orders rows against a prefix by their first prefix.size() bytes */
+struct TypeAheadPrefixLess
+{
+    const GUIStringTable *keys;
+
+    bool operator()(int row, const std::string &prefix) const
+    {
+        return strncmp((*keys)[row], prefix.c_str(), prefix.size()) < 0;
+    }
+
+    bool operator()(const std::string &prefix, int row) const
+    {
+        return strncmp((*keys)[row], prefix.c_str(), prefix.size()) > 0;
+    }
+};
+
+static char foldChar(char c)
+{
+    return ('A' <= c && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+static bool foldedPrefix(const char *s, const std::string &prefix)
+{
+    for(size_t i = 0; i < prefix.size(); i++)
+        if(s[i] == '\0' || foldChar(s[i]) != prefix[i])
+            return false;
+
+    return true;
+}
+
+static void buildTypeAhead(TypeAheadState *state, int count, GUIRowText text, void *user, unsigned int generation)
+{
+    static std::string key;
+
+    state->keys.clear();
+    state->order.resize(count);
+
+    for(int i = 0; i < count; i++)
+    {
+        key = text(i, user);
+
+        for(size_t j = 0; j < key.size(); j++)
+            key[j] = foldChar(key[j]);
+
+        state->keys.add(key);
+        state->order[i] = i;
+    }
+
+    TypeAheadLess less = { &state->keys };
+    std::sort(state->order.begin(), state->order.end(), less);
+
+    /* node i holds the lowest row under it, leaf count+i is order[i] */
+    state->min_row.resize(2*count);
+    std::copy(state->order.begin(), state->order.end(), state->min_row.begin() + count);
+
+    for(int i = count-1; i > 0; i--)
+        state->min_row[i] = std::min(state->min_row[2*i], state->min_row[2*i+1]);
+
+    state->count = count;
+    state->text = text;
+    state->user = user;
+    state->generation = generation;
+    state->built = true;
+    state->fresh = true;
+}
+
+/* lowest row whose key starts with the prefix, or -1 */
+static int findTypeAhead(TypeAheadState *state)
+{
+    TypeAheadPrefixLess less = { &state->keys };
+    std::pair<std::vector<int>::iterator, std::vector<int>::iterator> run =
+        std::equal_range(state->order.begin(), state->order.end(), state->prefix, less);
+
+    if(run.first == run.second)
+        return -1;
+
+    int n = state->count;
+    int lo = (run.first - state->order.begin()) + n;
+    int hi = (run.second - state->order.begin()) + n;
+    int row = INT_MAX;
+
+    for(; lo < hi; lo /= 2, hi /= 2)
+    {
+        if(lo & 1) row = std::min(row, state->min_row[lo++]);
+        if(hi & 1) row = std::min(row, state->min_row[--hi]);
+    }
+
+    return row;
+}
+
+/*
+ * Adds the keys typed this pass to the prefix and looks it up. Returns true
+ * and sets *choice if a row starts with it.
+ */
+static bool typeAhead(TypeAheadState *state, int count, GUIRowText text, void *user, unsigned int generation, int *choice)
+{
+    if(keyboard.control || keyboard.alt)
+        return false;
+
+    static std::string typed;
+    typed.clear();
+
+    for(size_t i = 0; i < keyboard.text.size(); i++)
+        if((unsigned char)keyboard.text[i] >= ' ' && keyboard.text[i] != 0x7f)
+            typed += foldChar(keyboard.text[i]);
+
+    if(keyboard.is_key_typed && keyboard.key_typed >= ' ' && keyboard.key_typed != 0x7f)
+    {
+        char buf[4];
+        int n = encodeUTF8(keyboard.key_typed, buf);
+
+        for(int i = 0; i < n; i++)
+            typed += foldChar(buf[i]);
+    }
+
+    float now = typeahead_clock.GetElapsedTime();
+
+    if(now - state->last_key > TYPEAHEAD_TIMEOUT)
+    {
+        state->prefix.clear();
+        state->fresh = false;
+    }
+
+    if(!typed.empty())
+    {
+        state->prefix += typed;
+    }
+    else if(keyboard.key_pressed == sf::Key::Back && !state->prefix.empty())
+    {
+        /* drop the last UTF-8 character */
+        size_t n = state->prefix.size() - 1;
+        while(n > 0 && (state->prefix[n] & 0xc0) == 0x80)
+            n--;
+        state->prefix.resize(n);
+    }
+    else
+    {
+        if(keyboard.key_pressed == sf::Key::Escape)
+        {
+            state->prefix.clear();
+            state->fresh = false;
+        }
+        return false;
+    }
+
+    state->last_key = now;
+
+    if(state->prefix.empty() || count == 0)
+        return false;
+
+    if(!state->built || state->count != count || state->text != text || state->user != user || state->generation != generation)
+        buildTypeAhead(state, count, text, user, generation);
+
+    int row = findTypeAhead(state);
+
+    if(generation == 0 && (row >= 0 ? !foldedPrefix(text(row, user), state->prefix) : !state->fresh))
+    {
+        buildTypeAhead(state, count, text, user, generation);
+        row = findTypeAhead(state);
+    }
+
+    if(row < 0 || row == *choice)
+        return false;
+
+    *choice = row;
+    return true;
+}
+
+/*
+ * Keys go to the list once it has been clicked, or always when has_keys is
+ * set by an owner like an open drop list.
+ */
+static bool scrolledListbox(GUIID id, float x, float y, float w, float h, int count, GUIRowText text, void *user, unsigned int generation, bool has_keys, int *choice, cml::vector2i *scroll)
 {
     event_bits = 0;
 
     int items_on_screen = h/listbox_item_height;
 
-    GUI_BeginGroup(x, y, w, h);
-        if(GUI_Scrollbar(id+"/_0", w-16, 0, 16, h, GUI_VERTICAL, 0, data.size(), items_on_screen, &((*scroll)[1])))
+    GUI_PushID(id);
+    GUIID list_id = GUI_ScopedID(1);
+    TypeAheadState *find = GUI_GetState<TypeAheadState>(GUI_ScopedID("_find"));
+
+    if(GUI_BeginGroup(x, y, w, h))
+    {
+        if(GUI_Scrollbar(GUI_ScopedID(0), w-16, 0, 16, h, GUI_VERTICAL, 0, count, items_on_screen, &((*scroll)[1])))
             event_bits |= GUI_EVT_SCROLLED;
 
-        if(GUI_Listbox(id+"/_1", 0, 0, w-16, h, data, (*scroll)[1], choice))
+        if(GUI_Listbox(list_id, 0, 0, w-16, h, count, text, user, (*scroll)[1], choice))
             event_bits |= GUI_EVT_CHOICE;
+    }
     GUI_EndGroup();
+    GUI_PopID();
 
-    if(pass == GUI_PASS_RESPONSE)
+    if(isResponsePass())
     {
-        if(hot_widget == id+"/_1")
+        if(hot_widget == list_id.hash)
         {
-            if(mouse.wheel_delta > 0)
-                (*scroll)[1] = cml::clamp((*scroll)[1] - 1, 0, std::max(0, (int)data.size()-items_on_screen));
-            else if(mouse.wheel_delta < 0)
-                (*scroll)[1] = cml::clamp((*scroll)[1] + 1, 0, std::max(0, (int)data.size()-items_on_screen));
-
+            /* queued wheel events are merged so the delta can be more than one notch */
             if(mouse.wheel_delta != 0)
+            {
+                (*scroll)[1] = cml::clamp((*scroll)[1] - mouse.wheel_delta, 0, std::max(0, count-items_on_screen));
                 event_bits |= GUI_EVT_SCROLLED;
+            }
+        }
+
+        if((has_keys || active_widget == list_id.hash) && typeAhead(find, count, text, user, generation, choice))
+        {
+            event_bits |= GUI_EVT_CHOICE | GUI_EVT_FOUND;
+
+            /* bring the row found into view */
+            if(*choice < (*scroll)[1] || *choice >= (*scroll)[1] + items_on_screen)
+            {
+                (*scroll)[1] = cml::clamp(*choice - items_on_screen/2, 0, std::max(0, count-items_on_screen));
+                event_bits |= GUI_EVT_SCROLLED;
+            }
         }
     }
 
     return event_bits != 0;
 }
 
-bool GUI_ListboxMulti(const std::string &id, float x, float y, float w, float h, const std::vector<std::string> &data, int data_offset, std::vector<bool> *selected)
+bool GUI_ScrolledListbox(GUIID id, float x, float y, float w, float h, const GUIStringTable &data, int *choice, cml::vector2i *scroll)
+{
+    return scrolledListbox(id, x, y, w, h, data.size(), tableRow, (void*)&data, data.generation(), false, choice, scroll);
+}
+
+bool GUI_ScrolledListbox(GUIID id, float x, float y, float w, float h, const std::vector<std::string> &data, int *choice, cml::vector2i *scroll)
+{
+    return scrolledListbox(id, x, y, w, h, data.size(), vectorRow, (void*)&data, 0, false, choice, scroll);
+}
+
+bool GUI_ScrolledListbox(GUIID id, float x, float y, float w, float h, int count, GUIRowText text, void *user, int *choice, cml::vector2i *scroll)
+{
+    return scrolledListbox(id, x, y, w, h, count, text, user, 0, false, choice, scroll);
+}
+
+struct ScrollState
+{
+    cml::vector2i scroll;
+
+    ScrollState() { scroll.zero(); }
+};
+
+bool GUI_ScrolledListbox(GUIID id, float x, float y, float w, float h, const std::vector<std::string> &data, int *choice)
+{
+    ScrollState *state = GUI_GetState<ScrollState>(id);
+    return GUI_ScrolledListbox(id, x, y, w, h, data, choice, &state->scroll);
+}
+
+bool GUI_ScrolledListbox(GUIID id, float x, float y, float w, float h, const GUIStringTable &data, int *choice)
+{
+    ScrollState *state = GUI_GetState<ScrollState>(id);
+    return GUI_ScrolledListbox(id, x, y, w, h, data, choice, &state->scroll);
+}
+
+bool GUI_ScrolledListbox(GUIID id, float x, float y, float w, float h, int count, GUIRowText text, void *user, int *choice)
+{
+    ScrollState *state = GUI_GetState<ScrollState>(id);
+    return GUI_ScrolledListbox(id, x, y, w, h, count, text, user, choice, &state->scroll);
+}
+
+/* GUI_Listbox for rows of differing height, scroll pixels down */
+static bool rowsListbox(GUIID id, float x, float y, float w, float h, int count, GUIRowText text, void *user, const GUIRowHeights &heights, int scroll, int *choice)
 {
     bool event = false;
 
-    if(pass == GUI_PASS_EVENT)
+    genericHotActive(id, x, y, w, h);
+
+    if(isResponsePass())
     {
-        genericHotActive(id, x, y, w, h);
+        if(hot_widget == id.hash && mouse.left_just_pressed && count > 0)
+        {
+            int item = heights.rowAt(scroll + double(mouse.y - y));
+
+            if(item != *choice)
+            {
+                *choice = item;
+                event = true;
+            }
+        }
     }
-    else if(pass == GUI_PASS_RESPONSE)
+
+    if(isDrawPass())
+    {
+        if(GUI_BeginGroup(x, y, w, h))
+            GUI_DrawListboxRows(0.0f, 0.0f, w, h, listbox_item_height, count, text, user, heights, scroll, *choice);
+        GUI_EndGroup();
+    }
+
+    return event;
+}
+
+/*
+ * Listbox whose rows can each have their own height, scrolled a pixel at a
+ * time. heights is kept at count rows, any new rows getting the standard
+ * item height, and the caller sets the heights of the rows that differ.
+ * *scroll is how many pixels the top of the list is scrolled past.
+ */
+bool GUI_ScrolledListbox(GUIID id, float x, float y, float w, float h, int count, GUIRowText text, void *user, GUIRowHeights *heights, int *choice, int *scroll)
+{
+    event_bits = 0;
+
+    if(heights->count() != count)
+        heights->resize(count, listbox_item_height);
+
+    int page = h;
+    int total = (int)std::min(heights->total(), (double)INT_MAX);
+    *scroll = cml::clamp(*scroll, 0, std::max(0, total-page));
+
+    GUI_PushID(id);
+    GUIID list_id = GUI_ScopedID(1);
+
+    if(GUI_BeginGroup(x, y, w, h))
+    {
+        if(GUI_Scrollbar(GUI_ScopedID(0), w-16, 0, 16, h, GUI_VERTICAL, 0, total, page, scroll, int(listbox_item_height)))
+            event_bits |= GUI_EVT_SCROLLED;
+
+        if(rowsListbox(list_id, 0, 0, w-16, h, count, text, user, *heights, *scroll, choice))
+            event_bits |= GUI_EVT_CHOICE;
+    }
+    GUI_EndGroup();
+    GUI_PopID();
+
+    if(isResponsePass())
+    {
+        if(hot_widget == list_id.hash && mouse.wheel_delta != 0)
+        {
+            *scroll = cml::clamp(*scroll - int(mouse.wheel_delta * listbox_item_height), 0, std::max(0, total-page));
+            event_bits |= GUI_EVT_SCROLLED;
+        }
+    }
+
+    return event_bits != 0;
+}
+
+struct PixelScrollState
+{
+    int scroll;
+
+    PixelScrollState() : scroll(0) {}
+};
+
+bool GUI_ScrolledListbox(GUIID id, float x, float y, float w, float h, int count, GUIRowText text, void *user, GUIRowHeights *heights, int *choice)
+{
+    PixelScrollState *state = GUI_GetState<PixelScrollState>(id);
+    return GUI_ScrolledListbox(id, x, y, w, h, count, text, user, heights, choice, &state->scroll);
+}
+
+bool GUI_ListboxMulti(GUIID id, float x, float y, float w, float h, const GUIStringTable &data, int data_offset, GUISelection *selected)
+{
+    return GUI_ListboxMulti(id, x, y, w, h, data.size(), tableRow, (void*)&data, data_offset, selected);
+}
+
+bool GUI_ListboxMulti(GUIID id, float x, float y, float w, float h, const std::vector<std::string> &data, int data_offset, GUISelection *selected)
+{
+    return GUI_ListboxMulti(id, x, y, w, h, data.size(), vectorRow, (void*)&data, data_offset, selected);
+}
+
+bool GUI_ListboxMulti(GUIID id, float x, float y, float w, float h, int count, GUIRowText text, void *user, int data_offset, GUISelection *selected)
+{
+    bool event = false;
+
+    if(selected->count() != count)
+        selected->resize(count);
+
+    genericHotActive(id, x, y, w, h);
+
+    if(isResponsePass())
     {
-        if(hot_widget == id && mouse.left_just_pressed && !data.empty())
+        if(hot_widget == id.hash && mouse.left_just_pressed && count > 0)
         {
             int item = (mouse.y - y) / listbox_item_height;
-            item = cml::clamp(item + data_offset, 0, (int)data.size()-1);
+            item = cml::clamp(item + data_offset, 0, count-1);
 
-            if(keyboard.control)
+            if(keyboard.shift)
             {
-                (*selected)[item] = !(*selected)[item];
+                /* select from the anchor, adding to the selection with control held */
+                int anchor = cml::clamp(selected->anchor, 0, count-1);
+
+                if(!keyboard.control)
+                    selected->clear();
+                selected->select(std::min(anchor, item), std::max(anchor, item)+1);
             }
-            else if(keyboard.shift)
+            else if(keyboard.control)
             {
-                //TODO proper shift selection. will probably need to store the last selected item
-#if 0
-                for(size_t i = item; i < selected->size(); i++)
-                {
-                    if(!(*selected)[i])
-                        (*selected)[i] = true;
-                    else
-                        break;
-                }
-
-                if(item > 0) // size_t will wrap otherwise
-                {
-                    for(size_t i = item-1; i >= 0; i--)
-                    {
-                        if(!(*selected)[i])
-                            (*selected)[i] = true;
-                        else
-                            break;
-                    }
-                }
-#endif
+                selected->toggle(item);
+                selected->anchor = item;
             }
             else
             {
-                for(size_t i = 0; i < selected->size(); i++)
-                    (*selected)[i] = false;
-                (*selected)[item] = true;
+                selected->clear();
+                selected->select(item, item+1);
+                selected->anchor = item;
             }
 
             event = true;
         }
-        else if(keyboard.control && keyboard.key_pressed == sf::Key::A && hot_widget == id)
+        else if(keyboard.control && keyboard.key_pressed == sf::Key::A && hot_widget == id.hash)
         {
-            for(size_t i = 0; i < selected->size(); i++)
-                (*selected)[i] = true;
+            selected->selectAll();
             event = true;
         }
     }
-    else if(pass == GUI_PASS_DRAW)
+
+    if(isDrawPass())
     {
-        GUI_BeginGroup(x, y, w, h);
-        GUI_DrawListboxMulti(0.0f, 0.0f, w, h, listbox_item_height, data, data_offset, *selected);
+        if(GUI_BeginGroup(x, y, w, h))
+            GUI_DrawListboxMulti(0.0f, 0.0f, w, h, listbox_item_height, count, text, user, data_offset, *selected);
         GUI_EndGroup();
     }
 
     return event;
 }
 
-bool GUI_ScrolledListboxMulti(const std::string &id, float x, float y, float w, float h, const std::vector<std::string> &data, std::vector<bool> *selected, cml::vector2i *scroll)
+bool GUI_ScrolledListboxMulti(GUIID id, float x, float y, float w, float h, const GUIStringTable &data, GUISelection *selected, cml::vector2i *scroll)
+{
+    return GUI_ScrolledListboxMulti(id, x, y, w, h, data.size(), tableRow, (void*)&data, selected, scroll);
+}
+
+bool GUI_ScrolledListboxMulti(GUIID id, float x, float y, float w, float h, const std::vector<std::string> &data, GUISelection *selected, cml::vector2i *scroll)
+{
+    return GUI_ScrolledListboxMulti(id, x, y, w, h, data.size(), vectorRow, (void*)&data, selected, scroll);
+}
+
+bool GUI_ScrolledListboxMulti(GUIID id, float x, float y, float w, float h, int count, GUIRowText text, void *user, GUISelection *selected, cml::vector2i *scroll)
 {
     event_bits = 0;
 
     int items_on_screen = h/listbox_item_height;
 
-    GUI_BeginGroup(x, y, w, h);
-        if(GUI_Scrollbar(id+"/_0", w-16, 0, 16, h, GUI_VERTICAL, 0, data.size(), items_on_screen, &((*scroll)[1])))
+    GUI_PushID(id);
+    GUIID list_id = GUI_ScopedID(1);
+
+    if(GUI_BeginGroup(x, y, w, h))
+    {
+        if(GUI_Scrollbar(GUI_ScopedID(0), w-16, 0, 16, h, GUI_VERTICAL, 0, count, items_on_screen, &((*scroll)[1])))
             event_bits |= GUI_EVT_SCROLLED;
 
-        if(GUI_ListboxMulti(id+"/_1", 0, 0, w-16, h, data, (*scroll)[1], selected))
+        if(GUI_ListboxMulti(list_id, 0, 0, w-16, h, count, text, user, (*scroll)[1], selected))
             event_bits |= GUI_EVT_CHOICE;
+    }
     GUI_EndGroup();
+    GUI_PopID();
 
-    if(pass == GUI_PASS_RESPONSE)
+    if(isResponsePass())
     {
-        if(hot_widget == id+"/_1")
+        if(hot_widget == list_id.hash)
         {
-            if(mouse.wheel_delta > 0)
-                (*scroll)[1] = cml::clamp((*scroll)[1] - 1, 0, std::max(0, (int)data.size()-items_on_screen));
-            else if(mouse.wheel_delta < 0)
-                (*scroll)[1] = cml::clamp((*scroll)[1] + 1, 0, std::max(0, (int)data.size()-items_on_screen));
-
+            /* queued wheel events are merged so the delta can be more than one notch */
             if(mouse.wheel_delta != 0)
+            {
+                (*scroll)[1] = cml::clamp((*scroll)[1] - mouse.wheel_delta, 0, std::max(0, count-items_on_screen));
                 event_bits |= GUI_EVT_SCROLLED;
+            }
         }
     }
 
     return event_bits != 0;
 }
 
-void GUI_BeginScrollArea(const std::string &id, float x, float y, float w, float h, float scroll_size, int min_scroll_x, int max_scroll_x, int min_scroll_y, int max_scroll_y, cml::vector2i *scroll)
+bool GUI_BeginScrollArea(GUIID id, float x, float y, float w, float h, float scroll_size, int min_scroll_x, int max_scroll_x, int min_scroll_y, int max_scroll_y, cml::vector2i *scroll)
 {
-    GUI_Slider(id+"/_0", x+w-scroll_size, y, scroll_size, h-scroll_size, GUI_HORIZONTAL, min_scroll_x, max_scroll_x, w, &((*scroll)[0]));
-    GUI_Slider(id+"/_1", x, y+h-scroll_size, w-scroll_size, scroll_size, GUI_HORIZONTAL, min_scroll_y, max_scroll_y, h, &((*scroll)[1]));
+    GUI_PushID(id);
+    GUI_Slider(GUI_ScopedID(0), x+w-scroll_size, y, scroll_size, h-scroll_size, GUI_HORIZONTAL, min_scroll_x, max_scroll_x, w, &((*scroll)[0]));
+    GUI_Slider(GUI_ScopedID(1), x, y+h-scroll_size, w-scroll_size, scroll_size, GUI_HORIZONTAL, min_scroll_y, max_scroll_y, h, &((*scroll)[1]));
+    GUI_PopID();
 
-    GUI_BeginGroup(x, y, w-scroll_size, h-scroll_size);
+    bool visible = GUI_BeginGroup(x, y, w-scroll_size, h-scroll_size);
     GUI_PushTranslation();
     GUI_Translate(0, -(*scroll)[1]);
+
+    return visible;
 }
 
 void GUI_EndScrollArea()
@@ -1074,7 +2216,7 @@ void GUI_BeginPopupGroup(PopupNode *root)
 
 void GUI_EndPopupGroup()
 {
-    if(pass == GUI_PASS_RESPONSE)
+    if(isResponsePass())
     {
         bool click_outside_group = popup_group_root != NULL && !mouse_in_popup_group && mouse.left_just_pressed;
         bool mouse_in_menu = in_drop_menu && drop_menu_mouse_in;
@@ -1089,7 +2231,7 @@ void GUI_EndPopupGroup()
     GUI_PopLayer();
 }
 
-void GUI_BeginPopupMenu(const std::string &id, float x, float y, float w, float h, float item_h, PopupNode *root)
+void GUI_BeginPopupMenu(GUIID id, float x, float y, float w, float h, float item_h, PopupNode *root)
 {
     popup_root = root;
     popup_y_coord = 0.0f;
@@ -1097,16 +2239,15 @@ void GUI_BeginPopupMenu(const std::string &id, float x, float y, float w, float
     popup_item_height = item_h;
     GUI_BeginGroup(x, y, w, h);
 
-    if(pass == GUI_PASS_EVENT)
-    {
-        genericHotActive(id, 0.0f, 0.0f, w, h);
-    }
-    else if(pass == GUI_PASS_RESPONSE)
+    genericHotActive(id, 0.0f, 0.0f, w, h);
+
+    if(isResponsePass())
     {
         if(!mouse_in_popup_group)
             mouse_in_popup_group = mouseIn(0.0f, 0.0f, w, h);
     }
-    else if(pass == GUI_PASS_DRAW)
+
+    if(isDrawPass())
     {
         GUI_DrawPopup(0.0f, 0.0f, w, h);
     }
@@ -1118,7 +2259,7 @@ void GUI_EndPopupMenu()
     popup_root = NULL;
 }
 
-bool GUI_PopupMenuButton(const std::string &id, const std::string &left_str, const std::string &right_str)
+bool GUI_PopupMenuButton(GUIID id, const std::string &left_str, const std::string &right_str)
 {
     float x = 0.0f;
     float y = popup_y_coord;
@@ -1128,29 +2269,29 @@ bool GUI_PopupMenuButton(const std::string &id, const std::string &left_str, con
 
     popup_y_coord += popup_item_height;
 
-    if(pass != GUI_PASS_DRAW)
-        evt = GUI_Button(id, x, y, w, h, "");
+    evt = buttonBehavior(id, x, y, w, h);
 
-    if(pass == GUI_PASS_RESPONSE)
+    if(isResponsePass())
     {
         if(evt)
         {
             deactivateTree(popup_group_root);
         }
-        else if(id == hot_widget)
+        else if(id.hash == hot_widget)
         {
             deactivateChildrenRecursive(popup_root);
         }
     }
-    else if(pass == GUI_PASS_DRAW)
+
+    if(isDrawPass())
     {
-        GUI_DrawPopupButton(x, y, w, h, hot_widget == id, active_widget == id, left_str, right_str);
+        GUI_DrawPopupButton(x, y, w, h, hot_widget == id.hash, active_widget == id.hash, left_str, right_str);
     }
 
     return evt;
 }
 
-void GUI_PopupSubMenuButton(const std::string &id, PopupNode *node)
+void GUI_PopupSubMenuButton(GUIID id, PopupNode *node)
 {
     float x = 0.0f;
     float y = popup_y_coord;
@@ -1159,27 +2300,26 @@ void GUI_PopupSubMenuButton(const std::string &id, PopupNode *node)
 
     popup_y_coord += popup_item_height;
 
-    if(pass == GUI_PASS_EVENT)
-    {
-        hotTest(id, x, y, w, h);
-    }                                           
-    else if(pass == GUI_PASS_RESPONSE)
+    hotTest(id, x, y, w, h);
+
+    if(isResponsePass())
     {
-        if(hot_widget == id)
+        if(hot_widget == id.hash)
         {
             deactivateRootChildren(popup_group_root);
             activateToRoot(node);
         }
     }
-    else if(pass == GUI_PASS_DRAW)
+
+    if(isDrawPass())
     {
-        GUI_DrawPopupSubMenuButton(x, y, w, h, hot_widget == id, node->active, node->name.c_str());
+        GUI_DrawPopupSubMenuButton(x, y, w, h, hot_widget == id.hash, node->active, node->name.c_str());
     }
 }
 
 void GUI_PopupSeparator(float h)
 {
-    if(pass == GUI_PASS_DRAW)
+    if(isDrawPass())
     {
         GUI_DrawSeparator(0.0f, popup_y_coord, popup_item_width, h);
     }
@@ -1207,7 +2347,7 @@ void setActiveMenuItem(PopupNode *root, unsigned int index)
     root->children[index]->active = true;
 }
 
-bool GUI_BeginDropMenu(const std::string &id, float x, float y, float w, float h, float item_width, PopupNode *root)
+bool GUI_BeginDropMenu(GUIID id, float x, float y, float w, float h, float item_width, PopupNode *root)
 {
     in_drop_menu = true;
 
@@ -1217,38 +2357,40 @@ bool GUI_BeginDropMenu(const std::string &id, float x, float y, float w, float h
     bool evt = false;
     bool menu_is_open = false;
 
+    GUI_PushID(id);
+
     for(unsigned int i = 0; i < root->children.size(); i++)
     {
-        std::string iid = id + "/_" + boost::lexical_cast<std::string>(i);
+        GUIID iid = GUI_ScopedID(i);
         float ix = x + item_width*i;
         float iy = y;
         float iw = item_width;
         float ih = h;
 
-        if(pass != GUI_PASS_DRAW)
+        if(toggleBehavior(iid, ix, iy, iw, ih, &root->children[i]->active))
         {
-            if(GUI_ToggleButton(iid, ix, iy, iw, ih, "", &root->children[i]->active))
-            {
-                evt = true;
+            evt = true;
 
-                if(root->children[i]->active)
-                    setActiveMenuItem(root, i);
-                else
-                    deactivateAllMenuItems(root);
-            }
+            if(root->children[i]->active)
+                setActiveMenuItem(root, i);
+            else
+                deactivateAllMenuItems(root);
         }
-        else
+
+        if(isDrawPass())
         {
-            GUI_DrawDropMenuHeaderItem(ix, iy, iw, ih, hot_widget == iid, root->children[i]->active, root->children[i]->name);
+            GUI_DrawDropMenuHeaderItem(ix, iy, iw, ih, hot_widget == iid.hash, root->children[i]->active, root->children[i]->name);
         }
     }
 
 
-    if(pass == GUI_PASS_EVENT)
+    /* also needed in the response pass in case the event pass was skipped */
+    if(isEventPass() || isResponsePass())
     {
         drop_menu_mouse_in = mouseIn(0.0f, 0.0f, w, h);
     }
-    else if(pass == GUI_PASS_RESPONSE)
+
+    if(isResponsePass())
     {
         for(unsigned int i = 0; i < root->children.size(); i++)
             if(root->children[i]->active)
@@ -1257,14 +2399,15 @@ bool GUI_BeginDropMenu(const std::string &id, float x, float y, float w, float h
         if(menu_is_open)
         {
             for(unsigned int i = 0; i < root->children.size(); i++)
-                if(hot_widget == id + "/_" + boost::lexical_cast<std::string>(i) && !root->children[i]->active)
+                if(hot_widget == GUI_ScopedID(i).hash && !root->children[i]->active)
                 {
                     setActiveMenuItem(root, i);
                     evt = true;
                 }
         }
     }
-    else if(pass == GUI_PASS_DRAW)
+
+    if(isDrawPass())
     {
         //FIXME get rid of this
         //window.Draw(sf::Shape::Rectangle(w_offset[0], w_offset[1], w_offset[0]+w, w_offset[1]+h, sf::Color::White));
@@ -1275,6 +2418,8 @@ bool GUI_BeginDropMenu(const std::string &id, float x, float y, float w, float h
         }
     }
 
+    GUI_PopID();
+
     return evt;
 }
 
@@ -1300,54 +2445,233 @@ void GUI_EndDropMenu()
 
 
 
-static bool doEditBoxResponse(int &caret_pos, int &selection, std::string *str);
-static void eraseSelection(int &caret_pos, int &selection, std::string *str);
+/*
+ * Edit box strings are UTF-8 and the caret and selection count characters.
+ * bytes holds the byte offset of every character in the string and pos its x
+ * position, each with an extra entry for the end. Both are kept in the state
+ * store and updated in place as characters are inserted and erased, so
+ * moving the caret never rescans the string. They're rebuilt whenever the
+ * string or font changes behind the edit box's back. pos is empty without a
+ * font.
+ */
+struct EditLayout
+{
+    const sf::Font *font;
+    unsigned int font_gen;
+    int size;
+    GUIHash str_hash;
+    unsigned int checked;   /* frame str_hash was last compared with the string */
+    bool edited;            /* the widget changed the string since then */
+    std::vector<int> bytes;
+    std::vector<float> pos;
+
+    EditLayout() : font(NULL), font_gen(0), size(0), str_hash(0), checked(0), edited(false) {}
+
+    int length() const { return bytes.size() - 1; }
+};
 
-bool GUI_EditBox(const std::string &id, float x, float y, float w, float h, GUIEditBoxData *data)
+static EditLayout *editLayout(GUIID id, const std::string &str)
+{
+    GUI_PushID(id);
+    EditLayout *l = GUI_GetState<EditLayout>(GUI_ScopedID("_layout"));
+    GUI_PopID();
+
+    const sf::Font *f = font.valid ? font.sf_font : NULL;
+    unsigned int frame = GUI_StateFrame();
+
+    bool stale = l->font != f || l->font_gen != GUI_FontGeneration() || l->size != font.size || l->bytes.empty() || l->bytes.back() != (int)str.size();
+    bool hashed = false;
+
+    /*
+     * the string is only hashed once a frame. Edits made by the widget keep
+     * the layout in step, so then the hash is just brought up to date.
+     */
+    if(!stale && l->checked != frame)
+    {
+        GUIHash h = GUI_HashBytes(str.data(), str.size());
+
+        if(!l->edited && l->str_hash != h)
+            stale = true;
+
+        l->str_hash = h;
+        l->checked = frame;
+        l->edited = false;
+        hashed = true;
+    }
+
+    if(stale)
+    {
+        l->font = f;
+        l->font_gen = GUI_FontGeneration();
+        l->size = font.size;
+        if(!hashed) l->str_hash = GUI_HashBytes(str.data(), str.size());
+        l->checked = frame;
+        l->edited = false;
+        l->bytes.clear();
+        l->pos.clear();
+
+        const std::vector<float> *pos = f != NULL ? &GUI_TextMetrics(f, font.size, str.data(), str.size()).pos : NULL;
+        size_t i = 0;
+
+        while(i < str.size())
+        {
+            l->bytes.push_back(i);
+            if(pos != NULL) l->pos.push_back((*pos)[i]);
+            GUI_DecodeUTF8(str.data(), str.size(), &i);
+        }
+
+        l->bytes.push_back(str.size());
+        if(pos != NULL) l->pos.push_back(pos->back());
+    }
+
+    return l;
+}
+
+/* inserts the characters of s before character at, returns how many there were */
+static int layoutInsert(EditLayout *l, int at, const char *s, int n)
+{
+    const GUIGlyphTable *t = l->font != NULL ? GUI_GlyphTable(l->font) : NULL;
+    float scale = t != NULL ? l->size / t->char_size : 0.0f;
+    float x = t != NULL ? l->pos[at] : 0.0f;
+    int byte = l->bytes[at];
+    int count = 0;
+    size_t i = 0;
+
+    l->edited = true;
+
+    static std::vector<int> bytes;
+    static std::vector<float> pos;
+    bytes.clear();
+    pos.clear();
+
+    while(i < (size_t)n)
+    {
+        bytes.push_back(byte + i);
+        pos.push_back(x);
+
+        unsigned int c = GUI_DecodeUTF8(s, n, &i);
+        if(t != NULL) x += GUI_Glyph(l->font, t, c).Advance * scale;
+        count++;
+    }
+
+    for(size_t k = at; k < l->bytes.size(); k++)
+        l->bytes[k] += n;
+    l->bytes.insert(l->bytes.begin() + at, bytes.begin(), bytes.end());
+
+    if(t != NULL)
+    {
+        float shift = x - l->pos[at];
+        for(size_t k = at; k < l->pos.size(); k++)
+            l->pos[k] += shift;
+        l->pos.insert(l->pos.begin() + at, pos.begin(), pos.end());
+    }
+
+    return count;
+}
+
+/* erases n characters starting at character at */
+static void layoutErase(EditLayout *l, int at, int n)
+{
+    int byte_shift = l->bytes[at+n] - l->bytes[at];
+
+    l->edited = true;
+
+    l->bytes.erase(l->bytes.begin() + at, l->bytes.begin() + at + n);
+
+    for(size_t i = at; i < l->bytes.size(); i++)
+        l->bytes[i] -= byte_shift;
+
+    if(l->pos.empty())
+        return;
+
+    float shift = l->pos[at+n] - l->pos[at];
+
+    l->pos.erase(l->pos.begin() + at, l->pos.begin() + at + n);
+
+    for(size_t i = at; i < l->pos.size(); i++)
+        l->pos[i] -= shift;
+}
+
+/* nearest caret position to x given the x position of each character */
+static int caretFromX(const std::vector<float> &pos, float x)
+{
+    int i = std::upper_bound(pos.begin(), pos.end(), x) - pos.begin();
+
+    if(i == 0)
+        return 0;
+    if(i == (int)pos.size())
+        return pos.size() - 1;
+
+    return (x - pos[i-1] < pos[i] - x) ? i-1 : i;
+}
+
+static bool doEditBoxResponse(int &caret_pos, int &selection, std::string *str, EditLayout *layout);
+static void eraseSelection(int &caret_pos, int &selection, std::string *str, EditLayout *layout);
+
+bool GUI_EditBox(GUIID id, float x, float y, float w, float h, GUIEditBoxData *data)
 {
     return GUI_EditBox(id, x, y, w, h, &data->caret_pos, &data->selection, &data->offset, data->str_ptr != NULL ? data->str_ptr : &data->str);
 }
 
-bool GUI_EditBox(const std::string &id, float x, float y, float w, float h, int *caret_pos, int *selection, float *offset, std::string *str)
+bool GUI_EditBox(GUIID id, float x, float y, float w, float h, int *caret_pos, int *selection, float *offset, std::string *str)
 {
     float padding = 5.0f;
     bool event = false;
     event_bits = 0;
 
-    *caret_pos = cml::clamp(*caret_pos, 0, (int)str->size());
-    *selection = cml::clamp(*selection, -*caret_pos, (int)str->size() - *caret_pos);
-    if(*offset < padding) *offset = padding;
+    genericHotActive(id, x, y, w, h);
 
-    if(pass == GUI_PASS_EVENT)
-    {
-        genericHotActive(id, x, y, w, h);
-    }
-    else if(pass == GUI_PASS_RESPONSE)
+    EditLayout *layout = editLayout(id, *str);
+    int length = layout->length();
+
+    *caret_pos = cml::clamp(*caret_pos, 0, length);
+    *selection = cml::clamp(*selection, -*caret_pos, length - *caret_pos);
+    if(*offset < padding) *offset = padding;
+
+    if(isResponsePass())
     {
-        if(active_widget == id)
-            event = doEditBoxResponse(*caret_pos, *selection, str);
+        if(active_widget == id.hash)
+        {
+            event = doEditBoxResponse(*caret_pos, *selection, str, layout);
+        }
 
-        if(font.valid)
+        if(!layout->pos.empty())
         {
-            sf::String txt(*str, *font.sf_font, font.size);
-            sf::Vector2f caret_vec = txt.GetCharacterPos(*caret_pos);
+            float mx = mouse.x - x - *offset;
+
+            if(hot_widget == id.hash && mouse.left_just_pressed)
+            {
+                *caret_pos = caretFromX(layout->pos, mx);
+                *selection = 0;
+            }
+            else if(active_widget == id.hash && mouse.left_down && mouse.dragged)
+            {
+                /* the end of the selection away from the caret stays put */
+                int anchor = *caret_pos + *selection;
+                *caret_pos = caretFromX(layout->pos, mx);
+                *selection = anchor - *caret_pos;
+            }
 
-            float caret_world = caret_vec.x + *offset;
+            float caret_x = layout->pos[*caret_pos];
+            float text_w = layout->pos.back();
+
+            float caret_world = caret_x + *offset;
 
             if(caret_world > w - 2.0f*padding)
-                *offset = -caret_vec.x + w - padding;
+                *offset = -caret_x + w - padding;
             else if(caret_world < padding)
-                *offset = -caret_vec.x + padding;
+                *offset = -caret_x + padding;
 
-            if(txt.GetRect().GetWidth() < w - 2.0f*padding)
+            if(text_w < w - 2.0f*padding)
                 *offset = padding;
         }
     }
-    else if(pass == GUI_PASS_DRAW)
+
+    if(isDrawPass())
     {
         //FIXME the drawing code should set the clip rect to clip the text
         GUI_PushClipRect(GUI_AABB::fromPositionSize(w_offset[0]+x, w_offset[1]+y, w, h));
-        GUI_DrawEditBox(x, y, w, h, active_widget == id, *caret_pos, *selection, *offset, *str);
+        GUI_DrawEditBox(x, y, w, h, active_widget == id.hash, *caret_pos, *selection, *offset, *str, layout->pos.empty() ? NULL : &layout->pos);
         GUI_PopClipRect();
     }
 
@@ -1356,7 +2680,13 @@ bool GUI_EditBox(const std::string &id, float x, float y, float w, float h, int
     return event;
 }
 
-static void eraseSelection(int &caret_pos, int &selection, std::string *str)
+bool GUI_EditBox(GUIID id, float x, float y, float w, float h, std::string *str)
+{
+    GUIEditBoxData *data = GUI_GetState<GUIEditBoxData>(id);
+    return GUI_EditBox(id, x, y, w, h, &data->caret_pos, &data->selection, &data->offset, str);
+}
+
+static void eraseSelection(int &caret_pos, int &selection, std::string *str, EditLayout *layout)
 {
     // work out for selection > 0
     int lower = caret_pos;
@@ -1364,25 +2694,50 @@ static void eraseSelection(int &caret_pos, int &selection, std::string *str)
 
     if(lower > upper) std::swap(lower, upper);
 
-    str->erase(lower, upper-lower);
+    str->erase(layout->bytes[lower], layout->bytes[upper] - layout->bytes[lower]);
+    layoutErase(layout, lower, upper-lower);
     selection = 0;
     caret_pos = lower;
 }
 
-bool doEditBoxResponse(int &caret_pos, int &selection, std::string *str)
+bool doEditBoxResponse(int &caret_pos, int &selection, std::string *str, EditLayout *layout)
 {
     bool event = false;
 
-    if(keyboard.is_key_typed)
+    /* a whole run of typed or pasted text goes in with one insert */
+    if(!keyboard.text.empty())
     {
-        if(' ' <= keyboard.key_typed && keyboard.key_typed <= '~')
+        static std::string run;
+        run.clear();
+
+        /* control characters are dropped, everything else is UTF-8 */
+        for(size_t i = 0; i < keyboard.text.size(); i++)
+        {
+            unsigned char c = keyboard.text[i];
+            if(c >= ' ' && c != 0x7f)
+                run += c;
+        }
+
+        if(!run.empty())
         {
-            std::cout << keyboard.key_typed << std::endl;
+            if(selection != 0) eraseSelection(caret_pos, selection, str, layout);
+
+            str->insert(layout->bytes[caret_pos], run);
+            caret_pos += layoutInsert(layout, caret_pos, run.data(), run.size());
+            event = true;
+        }
+    }
 
-            if(selection != 0) eraseSelection(caret_pos, selection, str);
+    if(keyboard.is_key_typed)
+    {
+        if(keyboard.key_typed >= ' ' && keyboard.key_typed != 0x7f)
+        {
+            if(selection != 0) eraseSelection(caret_pos, selection, str, layout);
 
-            str->insert(caret_pos, 1, (char)keyboard.key_typed);
-            caret_pos++;
+            char buf[4];
+            int n = encodeUTF8(keyboard.key_typed, buf);
+            str->insert(layout->bytes[caret_pos], buf, n);
+            caret_pos += layoutInsert(layout, caret_pos, buf, n);
             event = true;
         }
     }
@@ -1395,14 +2750,15 @@ bool doEditBoxResponse(int &caret_pos, int &selection, std::string *str)
             {
                 if(selection == 0)
                 {
-                    if(caret_pos > 0 && caret_pos <= str->size())
+                    if(caret_pos > 0)
                     {
-                        str->erase(caret_pos-1, 1);
+                        str->erase(layout->bytes[caret_pos-1], layout->bytes[caret_pos] - layout->bytes[caret_pos-1]);
+                        layoutErase(layout, caret_pos-1, 1);
                         caret_pos--;
                     }
                 }
                 else
-                    eraseSelection(caret_pos, selection, str);
+                    eraseSelection(caret_pos, selection, str, layout);
 
                 return true;
             }
@@ -1414,11 +2770,14 @@ bool doEditBoxResponse(int &caret_pos, int &selection, std::string *str)
             {
                 if(selection == 0)
                 {
-                    if(caret_pos >= 0 && caret_pos < str->size())
-                        str->erase(caret_pos, 1);
+                    if(caret_pos < layout->length())
+                    {
+                        str->erase(layout->bytes[caret_pos], layout->bytes[caret_pos+1] - layout->bytes[caret_pos]);
+                        layoutErase(layout, caret_pos, 1);
+                    }
                 }
                 else
-                    eraseSelection(caret_pos, selection, str);
+                    eraseSelection(caret_pos, selection, str, layout);
 
                 return true;
             }
@@ -1441,7 +2800,7 @@ bool doEditBoxResponse(int &caret_pos, int &selection, std::string *str)
         case sf::Key::Right:
         {
             int prev_caret_pos = caret_pos;
-            caret_pos = std::min(caret_pos+1, (int)str->size());
+            caret_pos = std::min(caret_pos+1, layout->length());
             if(keyboard.shift && caret_pos != prev_caret_pos)
                 selection--;
             else if(!keyboard.shift)
@@ -1452,7 +2811,7 @@ bool doEditBoxResponse(int &caret_pos, int &selection, std::string *str)
         {
             if(keyboard.control)
             {
-                caret_pos = str->size();
+                caret_pos = layout->length();
                 selection = -caret_pos;
             }
         }
@@ -1463,6 +2822,345 @@ bool doEditBoxResponse(int &caret_pos, int &selection, std::string *str)
 
 
 
+/*
+ * x position of each character on a line of a text editor. The reference is
+ * only good until the next GUI_TextMetrics() call.
+ */
+static const std::vector<float> &editorLinePos(const GUITextBuffer *text, size_t line)
+{
+    static std::string s;
+
+    size_t start = text->lineStart(line);
+    text->copy(start, text->lineEnd(line) - start, &s);
+
+    return GUI_TextMetrics(font.sf_font, font.size, s.data(), s.size()).pos;
+}
+
+static size_t editorCaretFromX(const GUITextBuffer *text, long line, float x)
+{
+    line = cml::clamp(line, 0L, (long)text->lineCount()-1);
+
+    if(!font.valid)
+        return text->lineStart(line);
+
+    return text->lineStart(line) + caretFromX(editorLinePos(text, line), x);
+}
+
+/* caret moved to another line, keeping its x position */
+static size_t editorCaretToLine(const GUITextBuffer *text, size_t caret, long line)
+{
+    size_t from = text->lineOf(caret);
+    float x = font.valid ? editorLinePos(text, from)[caret - text->lineStart(from)] : 0.0f;
+
+    return editorCaretFromX(text, line, x);
+}
+
+static void editorEraseSelection(GUITextEditorData *data, GUITextBuffer *text)
+{
+    size_t lower = std::min(data->caret, data->anchor);
+    size_t upper = std::max(data->caret, data->anchor);
+
+    text->erase(lower, upper-lower);
+    data->caret = data->anchor = lower;
+}
+
+static void editorInsert(GUITextEditorData *data, GUITextBuffer *text, const char *s, size_t len)
+{
+    editorEraseSelection(data, text);
+    text->insert(data->caret, s, len);
+    data->caret += len;
+    data->anchor = data->caret;
+}
+
+/* returns true if the text changed. moved is set if the caret moved. */
+static bool doTextEditorResponse(GUITextEditorData *data, GUITextBuffer *text, int page, bool *moved)
+{
+    bool changed = false;
+    bool move = false;
+    size_t caret = data->caret;
+    long line = text->lineOf(caret);
+
+    if(!keyboard.text.empty())
+    {
+        static std::string run;
+        run.clear();
+
+        for(size_t i = 0; i < keyboard.text.size(); i++)
+            if(' ' <= keyboard.text[i] && keyboard.text[i] <= '~')
+                run += keyboard.text[i];
+
+        if(!run.empty())
+        {
+            editorInsert(data, text, run.data(), run.size());
+            changed = true;
+        }
+    }
+
+    if(keyboard.is_key_typed && ' ' <= keyboard.key_typed && keyboard.key_typed <= '~')
+    {
+        char c = keyboard.key_typed;
+        editorInsert(data, text, &c, 1);
+        changed = true;
+    }
+
+    switch(keyboard.key_pressed)
+    {
+        case sf::Key::Return:
+            editorInsert(data, text, "\n", 1);
+            changed = true;
+            break;
+        case sf::Key::Back:
+            if(data->anchor == data->caret && data->caret > 0)
+                data->anchor = data->caret-1;
+            changed = data->anchor != data->caret;
+            editorEraseSelection(data, text);
+            break;
+        case sf::Key::Delete:
+            if(data->anchor == data->caret && data->caret < text->size())
+                data->anchor = data->caret+1;
+            changed = data->anchor != data->caret;
+            editorEraseSelection(data, text);
+            break;
+        case sf::Key::Left:
+            data->caret = caret > 0 ? caret-1 : 0;
+            move = true;
+            break;
+        case sf::Key::Right:
+            data->caret = std::min(caret+1, text->size());
+            move = true;
+            break;
+        case sf::Key::Up:       data->caret = editorCaretToLine(text, caret, line-1);    move = true; break;
+        case sf::Key::Down:     data->caret = editorCaretToLine(text, caret, line+1);    move = true; break;
+        case sf::Key::PageUp:   data->caret = editorCaretToLine(text, caret, line-page); move = true; break;
+        case sf::Key::PageDown: data->caret = editorCaretToLine(text, caret, line+page); move = true; break;
+        case sf::Key::Home:     data->caret = text->lineStart(line);                     move = true; break;
+        case sf::Key::End:      data->caret = text->lineEnd(line);                       move = true; break;
+        case sf::Key::A:
+            if(keyboard.control)
+            {
+                data->anchor = 0;
+                data->caret = text->size();
+            }
+            break;
+        default:
+            break;
+    }
+
+    if(move && !keyboard.shift)
+        data->anchor = data->caret;
+
+    *moved = changed || data->caret != caret;
+    return changed;
+}
+
+bool GUI_TextEditor(GUIID id, float x, float y, float w, float h, GUITextEditorData *data)
+{
+    GUITextBuffer *text = data->text_ptr != NULL ? data->text_ptr : &data->text;
+    float padding = 5.0f;
+    float bar_w = 16.0f;
+    float text_w = w - bar_w;
+    int lines_on_screen = std::max(1, (int)(h / editor_line_height));
+    bool changed = false;
+
+    event_bits = 0;
+
+    data->caret = std::min(data->caret, text->size());
+    data->anchor = std::min(data->anchor, text->size());
+    data->scroll = cml::clamp(data->scroll, 0, std::max(0, (int)text->lineCount()-lines_on_screen));
+    data->offset = std::min(data->offset, padding);
+
+    GUI_PushID(id);
+    GUIID text_id = GUI_ScopedID("_text");
+
+    if(GUI_BeginGroup(x, y, w, h))
+    {
+        if(GUI_Scrollbar(GUI_ScopedID("_scroll"), text_w, 0, bar_w, h, GUI_VERTICAL, 0, text->lineCount(), lines_on_screen, &data->scroll))
+            event_bits |= GUI_EVT_SCROLLED;
+
+        genericHotActive(text_id, 0, 0, text_w, h);
+
+        if(isResponsePass())
+        {
+            if(active_widget == text_id.hash)
+            {
+                bool moved;
+                changed = doTextEditorResponse(data, text, lines_on_screen, &moved);
+
+                /* keep the caret's line in view */
+                int line = text->lineOf(data->caret);
+
+                if(moved && line < data->scroll)
+                    data->scroll = line;
+                else if(moved && line >= data->scroll + lines_on_screen)
+                    data->scroll = line - lines_on_screen + 1;
+            }
+
+            bool press = hot_widget == text_id.hash && mouse.left_just_pressed;
+            bool drag = active_widget == text_id.hash && mouse.left_down && mouse.dragged;
+
+            if(font.valid && (press || drag))
+            {
+                long line = data->scroll + (long)floorf(mouse.y / editor_line_height);
+                data->caret = editorCaretFromX(text, line, mouse.x - data->offset);
+
+                if(press && !keyboard.shift)
+                    data->anchor = data->caret;
+            }
+
+            if(font.valid && active_widget == text_id.hash)
+            {
+                size_t line = text->lineOf(data->caret);
+                float caret_x = editorLinePos(text, line)[data->caret - text->lineStart(line)];
+                float caret_world = caret_x + data->offset;
+
+                if(caret_world > text_w - padding)
+                    data->offset = -caret_x + text_w - padding;
+                else if(caret_world < padding)
+                    data->offset = -caret_x + padding;
+            }
+
+            /* queued wheel events are merged so the delta can be more than one notch */
+            if(hot_widget == text_id.hash && mouse.wheel_delta != 0)
+            {
+                data->scroll = cml::clamp(data->scroll - 3*mouse.wheel_delta, 0, std::max(0, (int)text->lineCount()-lines_on_screen));
+                event_bits |= GUI_EVT_SCROLLED;
+            }
+        }
+
+        if(isDrawPass())
+        {
+            GUI_PushClipRect(GUI_AABB::fromPositionSize(w_offset[0], w_offset[1], text_w, h));
+            GUI_DrawTextEditor(0, 0, text_w, h, active_widget == text_id.hash, editor_line_height, data->offset, *text, data->scroll, data->caret, data->anchor);
+            GUI_PopClipRect();
+        }
+    }
+    GUI_EndGroup();
+    GUI_PopID();
+
+    return changed || event_bits != 0;
+}
+
+bool GUI_TextEditor(GUIID id, float x, float y, float w, float h, GUITextBuffer *text)
+{
+    GUITextEditorData *data = GUI_GetState<GUITextEditorData>(id);
+    data->text_ptr = text;
+    return GUI_TextEditor(id, x, y, w, h, data);
+}
+
+struct LogConsoleState
+{
+    size_t top;     /* number of the first line in view, counting dropped lines */
+    bool follow;
+
+    LogConsoleState() : top(0), follow(true) {}
+};
+
+bool GUI_LogConsole(GUIID id, float x, float y, float w, float h, GUILog *log)
+{
+    float bar_w = 16.0f;
+    int rows_on_screen = std::max(1, (int)(h / log_line_height));
+
+    event_bits = 0;
+
+    LogConsoleState *state = GUI_GetState<LogConsoleState>(id);
+
+    /* hold off the producer while the rows are read */
+    sf::Lock lock(log->mutex);
+
+    int count = log->lineCount();
+    int max_row = std::max(0, count - rows_on_screen);
+    int row;
+
+    /* lines dropped off the front pull the view down with them */
+    if(state->follow)
+        row = max_row;
+    else if(state->top < log->first())
+        row = 0;
+    else
+        row = std::min(state->top - log->first(), (size_t)max_row);
+
+    GUI_PushID(id);
+    GUIID list_id = GUI_ScopedID("_list");
+
+    if(GUI_BeginGroup(x, y, w, h))
+    {
+        if(GUI_Scrollbar(GUI_ScopedID("_scroll"), w-bar_w, 0, bar_w, h, GUI_VERTICAL, 0, count, rows_on_screen, &row))
+            event_bits |= GUI_EVT_SCROLLED;
+
+        genericHotActive(list_id, 0, 0, w-bar_w, h);
+
+        /* queued wheel events are merged so the delta can be more than one notch */
+        if(isResponsePass() && hot_widget == list_id.hash && mouse.wheel_delta != 0)
+        {
+            row = cml::clamp(row - 3*mouse.wheel_delta, 0, max_row);
+            event_bits |= GUI_EVT_SCROLLED;
+        }
+
+        if(isDrawPass())
+            GUI_DrawLogConsole(0, 0, w-bar_w, h, log_line_height, *log, row);
+    }
+    GUI_EndGroup();
+    GUI_PopID();
+
+    /* scrolling back to the bottom follows the tail again */
+    if(event_bits & GUI_EVT_SCROLLED)
+        state->follow = row >= max_row;
+
+    state->top = log->first() + row;
+
+    return event_bits != 0;
+}
+
+bool GUI_FileViewer(GUIID id, float x, float y, float w, float h, GUIMappedFile *file)
+{
+    float bar_w = 16.0f;
+    int rows_on_screen = std::max(1, (int)(h / log_line_height));
+
+    event_bits = 0;
+
+    ScrollState *state = GUI_GetState<ScrollState>(id);
+    int &row = state->scroll[1];
+
+    int count = std::min(file->lineCount(), (size_t)INT_MAX);
+    int max_row = std::max(0, count - rows_on_screen);
+    float progress = file->indexed() ? 1.0f : file->progress();
+
+    row = cml::clamp(row, 0, max_row);
+
+    GUI_PushID(id);
+    GUIID list_id = GUI_ScopedID("_list");
+
+    if(GUI_BeginGroup(x, y, w, h))
+    {
+        if(GUI_Scrollbar(GUI_ScopedID("_scroll"), w-bar_w, 0, bar_w, h, GUI_VERTICAL, 0, count, rows_on_screen, &row))
+            event_bits |= GUI_EVT_SCROLLED;
+
+        genericHotActive(list_id, 0, 0, w-bar_w, h);
+
+        /* queued wheel events are merged so the delta can be more than one notch */
+        if(isResponsePass() && hot_widget == list_id.hash && mouse.wheel_delta != 0)
+        {
+            row = cml::clamp(row - 3*mouse.wheel_delta, 0, max_row);
+            event_bits |= GUI_EVT_SCROLLED;
+        }
+
+        if(isDrawPass())
+        {
+            GUI_DrawFileViewer(0, 0, w-bar_w, h, log_line_height, *file, row, count, progress);
+
+            /* keep drawing while indexing moves the progress bar along */
+            if(progress < 1.0f)
+                GUI_RequestRedraw();
+        }
+    }
+    GUI_EndGroup();
+    GUI_PopID();
+
+    return event_bits != 0;
+}
+
+
+
 
 
 
@@ -1471,7 +3169,11 @@ bool doEditBoxResponse(int &caret_pos, int &selection, std::string *str)
 
 
 
-bool GUI_DropList(const std::string &id, float x, float y, float w, float h, const std::vector<std::string> &data, int *choice, bool *open)
+/*
+ * While the list is open it takes the keys, so typing moves the choice to the
+ * first match without closing it and return accepts it.
+ */
+static bool dropList(GUIID id, float x, float y, float w, float h, int count, GUIRowText text, void *user, unsigned int generation, int *choice, bool *open)
 {
     bool evt = false;
     float frame_padding = 1;
@@ -1479,42 +3181,64 @@ bool GUI_DropList(const std::string &id, float x, float y, float w, float h, con
     float lb_h = 100 - frame_padding*2.0f; //TODO list heigth
 
 
-    if(pass != GUI_PASS_DRAW)
-        GUI_ToggleButton(id, x, y, w, h, "", open);
+    toggleBehavior(id, x, y, w, h, open);
 
     if(*open)
     {
-        //FIXME take in as a parameter
-        static cml::vector2i lb_scrolls(0, 0);
-
         GUI_PushLayer();
         GUI_SetLayer(GUI_DROP_LIST_LAYER);
 
-        GUI_BeginFrame(x, y+h, w, 100, frame_padding, frame_padding);
-        if(GUI_ScrolledListbox(id + "/_list", 0.0f, 0.0f, lb_w, lb_h, data, choice, &lb_scrolls))
-            if(GUI_Event(GUI_EVT_CHOICE))
-            {
-                *open = false;
-                evt = true;
-            }
+        GUI_PushID(id);
+        if(GUI_BeginFrame(x, y+h, w, 100, frame_padding, frame_padding))
+        {
+            GUIID list_id = GUI_ScopedID("_list");
+            ScrollState *state = GUI_GetState<ScrollState>(list_id);
+
+            if(scrolledListbox(list_id, 0.0f, 0.0f, lb_w, lb_h, count, text, user, generation, true, choice, &state->scroll))
+                if(GUI_Event(GUI_EVT_CHOICE))
+                {
+                    if(!GUI_Event(GUI_EVT_FOUND))
+                        *open = false;
+                    evt = true;
+                }
+        }
         GUI_EndFrame();
+        GUI_PopID();
 
         GUI_PopLayer();
     }
 
-    if(pass == GUI_PASS_RESPONSE)
+    if(isResponsePass())
     {
         if(*open && mouse.left_just_pressed && !mouseIn(x, y, lb_w, lb_h))
             *open = false;
+        else if(*open && (keyboard.key_pressed == sf::Key::Return || keyboard.key_pressed == sf::Key::Escape))
+            *open = false;
     }
-    else if(pass == GUI_PASS_DRAW)
+
+    if(isDrawPass())
     {
-        GUI_DrawDropListHeader(x, y, w, h, *open, (0 <= *choice && *choice < data.size()) ? data[*choice] : "");
+        GUI_DrawDropListHeader(x, y, w, h, *open, (0 <= *choice && *choice < count) ? text(*choice, user) : "");
     }
 
     return evt;
 }
 
+bool GUI_DropList(GUIID id, float x, float y, float w, float h, const std::vector<std::string> &data, int *choice, bool *open)
+{
+    return dropList(id, x, y, w, h, data.size(), vectorRow, (void*)&data, 0, choice, open);
+}
+
+bool GUI_DropList(GUIID id, float x, float y, float w, float h, const GUIStringTable &data, int *choice, bool *open)
+{
+    return dropList(id, x, y, w, h, data.size(), tableRow, (void*)&data, data.generation(), choice, open);
+}
+
+bool GUI_DropList(GUIID id, float x, float y, float w, float h, int count, GUIRowText text, void *user, int *choice, bool *open)
+{
+    return dropList(id, x, y, w, h, count, text, user, 0, choice, open);
+}
+
 
 bool GUI_Event(int mask)
 {
@@ -1542,20 +3266,18 @@ bool GUI_IsMouseIn()
 
 
 
-void GUI_BeginWindow(const std::string &id, float *x, float *y, float w, float h, const std::string &title)
+bool GUI_BeginWindow(GUIID id, float *x, float *y, float w, float h, const std::string &title)
 {
     float top_border    = 24.0f;
     float bottom_border = 5.0f;
     float left_border   = 5.0f;
     float right_border  = 5.0f;
 
-    if(pass == GUI_PASS_EVENT)
-    {
-        genericHotActive(id, *x, *y, w, top_border);
-    }
-    else if(pass == GUI_PASS_RESPONSE)
+    genericHotActive(id, *x, *y, w, top_border);
+
+    if(isResponsePass())
     {
-        if(active_widget == id)
+        if(active_widget == id.hash)
         {
             if(mouse.dragged)
             {
@@ -1563,15 +3285,16 @@ void GUI_BeginWindow(const std::string &id, float *x, float *y, float w, float h
                 *y += mouse.dy;
             }
             else if(!mouse.left_down)
-                active_widget = "";
+                active_widget = 0;
         }
     }
-    else if(pass == GUI_PASS_DRAW)
+
+    if(isDrawPass() && GUI_IsVisible(*x, *y, w, h))
     {
         GUI_DrawWindow(*x, *y, w, h, title);
     }
 
-    GUI_BeginGroup(*x+left_border, *y+top_border, w-left_border-right_border, h-top_border-bottom_border);
+    return GUI_BeginGroup(*x+left_border, *y+top_border, w-left_border-right_border, h-top_border-bottom_border);
 }
 
 void GUI_EndWindow()
@@ -1605,11 +3328,13 @@ template<class T> GUISpinnerData GUI_CreateSpinnerData(T value)
     return d;
 }
 
-template<class T> bool GUI_Spinner(const std::string &id, float x, float y, float w, float h, GUISpinnerData *data, T min, T max, T *value)
+template<class T> bool GUI_Spinner(GUIID id, float x, float y, float w, float h, GUISpinnerData *data, T min, T max, T *value)
 {
     bool evt = false;
 
-    if(GUI_EditBox(id + "/_0", x, y, w-16, h, &data->caret, &data->selection, &data->offset, &data->text_str) && GUI_Event(GUI_EVT_CONFIRMED))
+    GUI_PushID(id);
+
+    if(GUI_EditBox(GUI_ScopedID(0), x, y, w-16, h, &data->caret, &data->selection, &data->offset, &data->text_str) && GUI_Event(GUI_EVT_CONFIRMED))
     {
         try
         {
@@ -1628,13 +3353,13 @@ template<class T> bool GUI_Spinner(const std::string &id, float x, float y, floa
     GUI_DrawSetButtonMode(GUI_BUTTON_DRAW_ARROW);
     GUI_PushButtonMode();
     GUI_ButtonMode(GUI_ACTIVATE_ON_DOWN);
-    if(GUI_Button(id + "/_inc", x+w-16, y, 16, h/2, "u"))
+    if(GUI_Button(GUI_ScopedID("_inc"), x+w-16, y, 16, h/2, "u"))
     {
         (*value)++;
         evt = true;
     }
 
-    if(GUI_Button(id + "/_dec", x+w-16, y+h/2, 16, h/2, "d"))
+    if(GUI_Button(GUI_ScopedID("_dec"), x+w-16, y+h/2, 16, h/2, "d"))
     {
         (*value)--;
         evt = true;
@@ -1642,6 +3367,8 @@ template<class T> bool GUI_Spinner(const std::string &id, float x, float y, floa
     GUI_PopButtonMode();
     GUI_DrawSetButtonMode(button_draw_mode);
 
+    GUI_PopID();
+
 
     if(evt)
     {
@@ -1652,6 +3379,27 @@ template<class T> bool GUI_Spinner(const std::string &id, float x, float y, floa
     return evt;
 }
 
+struct SpinnerState
+{
+    GUISpinnerData data;
+    bool initialized;
+
+    SpinnerState() { initialized = false; }
+};
+
+template<class T> bool GUI_Spinner(GUIID id, float x, float y, float w, float h, T min, T max, T *value)
+{
+    SpinnerState *state = GUI_GetState<SpinnerState>(id);
+
+    if(!state->initialized)
+    {
+        state->data = GUI_CreateSpinnerData(*value);
+        state->initialized = true;
+    }
+
+    return GUI_Spinner(id, x, y, w, h, &state->data, min, max, value);
+}
+
 template GUISpinnerData GUI_CreateSpinnerData<char>  (char   value);
 template GUISpinnerData GUI_CreateSpinnerData<short> (short  value);
 template GUISpinnerData GUI_CreateSpinnerData<int>   (int    value);
@@ -1659,12 +3407,19 @@ template GUISpinnerData GUI_CreateSpinnerData<long>  (long   value);
 template GUISpinnerData GUI_CreateSpinnerData<float> (float  value);
 template GUISpinnerData GUI_CreateSpinnerData<double>(double value);
 
-template bool GUI_Spinner<char>  (const std::string &id, float x, float y, float w, float h, GUISpinnerData *data, char   min, char   max, char   *value);
-template bool GUI_Spinner<short> (const std::string &id, float x, float y, float w, float h, GUISpinnerData *data, short  min, short  max, short  *value);
-template bool GUI_Spinner<int>   (const std::string &id, float x, float y, float w, float h, GUISpinnerData *data, int    min, int    max, int    *value);
-template bool GUI_Spinner<long>  (const std::string &id, float x, float y, float w, float h, GUISpinnerData *data, long   min, long   max, long   *value);
-template bool GUI_Spinner<float> (const std::string &id, float x, float y, float w, float h, GUISpinnerData *data, float  min, float  max, float  *value);
-template bool GUI_Spinner<double>(const std::string &id, float x, float y, float w, float h, GUISpinnerData *data, double min, double max, double *value);
+template bool GUI_Spinner<char>  (GUIID id, float x, float y, float w, float h, GUISpinnerData *data, char   min, char   max, char   *value);
+template bool GUI_Spinner<short> (GUIID id, float x, float y, float w, float h, GUISpinnerData *data, short  min, short  max, short  *value);
+template bool GUI_Spinner<int>   (GUIID id, float x, float y, float w, float h, GUISpinnerData *data, int    min, int    max, int    *value);
+template bool GUI_Spinner<long>  (GUIID id, float x, float y, float w, float h, GUISpinnerData *data, long   min, long   max, long   *value);
+template bool GUI_Spinner<float> (GUIID id, float x, float y, float w, float h, GUISpinnerData *data, float  min, float  max, float  *value);
+template bool GUI_Spinner<double>(GUIID id, float x, float y, float w, float h, GUISpinnerData *data, double min, double max, double *value);
+
+template bool GUI_Spinner<char>  (GUIID id, float x, float y, float w, float h, char   min, char   max, char   *value);
+template bool GUI_Spinner<short> (GUIID id, float x, float y, float w, float h, short  min, short  max, short  *value);
+template bool GUI_Spinner<int>   (GUIID id, float x, float y, float w, float h, int    min, int    max, int    *value);
+template bool GUI_Spinner<long>  (GUIID id, float x, float y, float w, float h, long   min, long   max, long   *value);
+template bool GUI_Spinner<float> (GUIID id, float x, float y, float w, float h, float  min, float  max, float  *value);
+template bool GUI_Spinner<double>(GUIID id, float x, float y, float w, float h, double min, double max, double *value);
 
 
 
@@ -1687,8 +3442,8 @@ template bool GUI_Spinner<double>(const std::string &id, float x, float y, float
 
 
 int GUI_GetPass()               { return pass; }
-std::string GUI_HotWidget()     { return hot_widget; }
-std::string GUI_ActiveWidget()  { return active_widget; }
+GUIHash GUI_HotWidgetID()       { return hot_widget; }
+GUIHash GUI_ActiveWidgetID()    { return active_widget; }
 bool GUI_MouseLeftJustPressed() { return mouse.left_just_pressed; }
 bool GUI_MouseLeftDown()        { return mouse.left_down; }
 bool GUI_MouseRightDown()       { return mouse.right_down; }
@@ -1698,7 +3453,35 @@ float GUI_MouseDX()             { return mouse.dx; }
 float GUI_MouseDY()             { return mouse.dy; }
 bool GUI_MouseDragged()         { return mouse.dragged; }
 int GUI_MouseWheelDelta()       { return mouse.wheel_delta; }
-void GUI_GenericHotActive(const std::string &id, float x, float y, float w, float h)     { genericHotActive(id, x, y, w, h); }
+void GUI_GenericHotActive(GUIID id, float x, float y, float w, float h)     { genericHotActive(id, x, y, w, h); }
+
+static std::string widgetName(GUIHash hash)
+{
+    if(hash == 0)
+        return "";
+
+    std::map<GUIHash, std::string>::iterator it = debug_names.find(hash);
+    if(it != debug_names.end())
+        return it->second;
+
+    char buf[32];
+    snprintf(buf, sizeof(buf), "#%016llx", hash);
+    return buf;
+}
+
+/*
+ * Without debug names enabled these return the hex hash of the widget.
+ */
+std::string GUI_HotWidget()     { return widgetName(hot_widget); }
+std::string GUI_ActiveWidget()  { return widgetName(active_widget); }
+
+void GUI_DebugNames(bool enable)
+{
+    debug_names_enabled = enable;
+
+    if(!enable)
+        debug_names.clear();
+}
 
 void GUI_LocalToWorld(float *x, float *y)
 {
@@ -1724,7 +3507,7 @@ void GUI_LocalToWorld(float *x, float *y)
 
 
 
-bool GUI_FileChooser(const std::string &id, float x, float y, float w, float h, GUIFileChooserData *data)
+bool GUI_FileChooser(GUIID id, float x, float y, float w, float h, GUIFileChooserData *data)
 {
     GUIDirContents &c = data->contents;
     int offset = data->scrolls[1];
@@ -1736,8 +3519,10 @@ bool GUI_FileChooser(const std::string &id, float x, float y, float w, float h,
     float ok_x = x+w-b_w*2, ok_y = y+h-25;
     float no_x = x+w-b_w*1, no_y = y+h-25;
 
+    GUI_PushID(id);
+
 #if 0
-    if(GUI_EditBox(id+"/_edit", x, y, pb_w, pb_h, &data->path_edit_data) && GUI_Event(GUI_EVT_CONFIRMED))
+    if(GUI_EditBox(GUI_ScopedID("_edit"), x, y, pb_w, pb_h, &data->path_edit_data) && GUI_Event(GUI_EVT_CONFIRMED))
     {
         std::string &str = data->path_edit_data.str;
         if(!data->exists(str))
@@ -1757,67 +3542,80 @@ bool GUI_FileChooser(const std::string &id, float x, float y, float w, float h,
     }
 #endif
 
-    if(pass == GUI_PASS_DRAW)
-    {
-        float dirfiles_w = 20.0f;
-        float sizes_w = 40.0f;
-        float types_w = 40.0f;
-        float names_w = w - dirfiles_w - sizes_w - types_w;
+    float dirfiles_w = 20.0f;
+    float sizes_w = 40.0f;
+    float types_w = 40.0f;
+    float names_w = w - dirfiles_w - sizes_w - types_w;
 
-        GUI_ListboxMulti(id+"/_l3", x, y+20, dirfiles_w, lh, c.dirfile, offset, &c.selected);
-        GUI_ListboxMulti(id+"/_l0", x+dirfiles_w, y+20, names_w, lh, c.names, offset, &c.selected);
-        GUI_ListboxMulti(id+"/_l2", x+dirfiles_w+names_w, y+20, sizes_w, lh, c.sizes, offset, &c.selected);
-        GUI_ScrolledListboxMulti(id+"/_l1", x+dirfiles_w+names_w+sizes_w, y+20, types_w, lh, c.types, &c.selected, &data->scrolls);
+    /*
+     * The columns share one selection so clicking any of them selects the
+     * row. Only the last column has a scrollbar; the others scroll with it.
+     */
+    GUIID dirfile_id = GUI_ScopedID("_l3");
+    GUIID names_id   = GUI_ScopedID("_l0");
+    GUIID sizes_id   = GUI_ScopedID("_l2");
+    bool chose = false;
+
+    if(GUI_ListboxMulti(dirfile_id, x, y+20, dirfiles_w, lh, c.dirfile, offset, &c.selected))
+        chose = true;
+    if(GUI_ListboxMulti(names_id, x+dirfiles_w, y+20, names_w, lh, c.names, offset, &c.selected))
+        chose = true;
+    if(GUI_ListboxMulti(sizes_id, x+dirfiles_w+names_w, y+20, sizes_w, lh, c.sizes, offset, &c.selected))
+        chose = true;
+    if(GUI_ScrolledListboxMulti(GUI_ScopedID("_l1"), x+dirfiles_w+names_w+sizes_w, y+20, types_w, lh, c.types, &c.selected, &data->scrolls) && GUI_Event(GUI_EVT_CHOICE))
+        chose = true;
+
+    if(isResponsePass() && mouse.wheel_delta != 0)
+    {
+        if(hot_widget == dirfile_id.hash || hot_widget == names_id.hash || hot_widget == sizes_id.hash)
+        {
+            int items_on_screen = lh/listbox_item_height;
+            data->scrolls[1] = cml::clamp(data->scrolls[1] - mouse.wheel_delta, 0, std::max(0, (int)c.names.size()-items_on_screen));
+        }
     }
-    else
+
+    if(chose)
     {
-        if(GUI_ScrolledListboxMulti(id+"/_l3", x, y+20, w, lh, c.dirfile, &c.selected, &data->scrolls) && GUI_Event(GUI_EVT_CHOICE))
+        int num_selected = 0;
+        int index = c.selected.nextSelected(0);
+
+        if(index < c.selected.count())
+            num_selected = c.selected.nextSelected(index+1) < c.selected.count() ? 2 : 1;
+
+        if(num_selected == 1)
         {
-            int num_selected = 0;
-            size_t index = 0;
+            printf("joining\n");
+            std::string str = data->joinPaths(data->dir, c.names[index]);
 
-            for(size_t i = 0; i < c.selected.size(); i++)
+            if(data->isDir(str) && data->getDirContents)
             {
-                if(c.selected[i])
-                {
-                    num_selected++;
-                    index = i;
-                }
+                printf("getting contents\n");
+                data->dir = str;
+                c.clear();
+                data->getDirContents(data->dir, &c);
+                c.sort();
             }
-
-            if(num_selected == 1)
+            else if(data->isFile(str))
             {
-                printf("joining\n");
-                std::string str = data->joinPaths(data->dir, c.names[index]);
-
-                if(data->isDir(str) && data->getDirContents)
-                {
-                    printf("getting contents\n");
-                    data->dir = str;
-                    c.clear();
-                    data->getDirContents(data->dir, &c);
-                    c.sort();
-                }
-                else if(data->isFile(str))
-                {
-                    data->file_edit_data.str = c.names[index];
-                    printf("is file\n");
-                }
+                data->file_edit_data.str = c.names[index];
+                printf("is file\n");
             }
         }
     }
 
     event_bits = 0;
 
-    if(data->is_save && GUI_EditBox(id+"/_edit", x, ok_y, w, b_h, &data->file_edit_data) && GUI_Event(GUI_EVT_CONFIRMED))
+    if(data->is_save && GUI_EditBox(GUI_ScopedID("_edit"), x, ok_y, w, b_h, &data->file_edit_data) && GUI_Event(GUI_EVT_CONFIRMED))
         event_bits |= GUI_EVT_CONFIRMED;
 
-    if(GUI_Button(id+"/_ok", ok_x, ok_y, b_w, b_h, data->is_save ? "Save" : "Open"))
+    if(GUI_Button(GUI_ScopedID("_ok"), ok_x, ok_y, b_w, b_h, data->is_save ? "Save" : "Open"))
         event_bits |= GUI_EVT_CONFIRMED;
 
-    if(GUI_Button(id+"/_no", no_x, no_y, b_w, b_h, "Cancel"))
+    if(GUI_Button(GUI_ScopedID("_no"), no_x, no_y, b_w, b_h, "Cancel"))
         event_bits |= GUI_EVT_CANCELLED;
 
+    GUI_PopID();
+
     return event_bits != 0;
 }
 
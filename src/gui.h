@@ -25,6 +25,15 @@ enum
      */
     GUI_PASS_DRAW,
 
+    /*
+     * Event, response and drawing in one pass. Widgets respond using the hot
+     * widget found during the previous single pass, so hot changes show up a
+     * frame late. Input given between passes accumulates until this pass
+     * consumes it. Use GUI_PASS_EVENT and GUI_PASS_RESPONSE instead when hot
+     * widget resolution has to be exact for the same input.
+     */
+    GUI_PASS_SINGLE,
+
     GUI_PASS_NONE,
 
 
@@ -56,11 +65,49 @@ enum
     GUI_EVT_CHOICE    = 0x0002,
     GUI_EVT_CONFIRMED = 0x0004,
     GUI_EVT_CANCELLED = 0x0008,
+    GUI_EVT_FOUND     = 0x0010,   /* type-ahead moved the choice */
 };
 
 #define GUI_MAX_LAYER 1024
 #define GUI_DROP_LIST_LAYER 1025
 
+
+/*
+ * Widgets are identified by a 64 bit FNV-1a hash of their id string. Hashing
+ * a string literal can be done at compile time with GUI_ID("some/id"); plain
+ * strings passed to widget functions are hashed when the call is made.
+ *
+ * A hash of 0 means "no widget".
+ */
+typedef unsigned long long GUIHash;
+
+#define GUI_HASH_OFFSET 14695981039346656037ULL
+#define GUI_HASH_PRIME  1099511628211ULL
+
+constexpr GUIHash GUI_HashStr(const char *s, GUIHash h = GUI_HASH_OFFSET)
+{
+    return *s ? GUI_HashStr(s + 1, (h ^ (unsigned char)*s) * GUI_HASH_PRIME) : h;
+}
+
+GUIHash GUI_HashBytes(const char *s, size_t len, GUIHash h = GUI_HASH_OFFSET);
+
+struct GUIID
+{
+    GUIHash hash;
+
+    /* original id string for the debug name table. may be NULL. */
+    const char *name;
+
+    constexpr GUIID() : hash(0), name(NULL) {}
+    constexpr GUIID(GUIHash h, const char *n) : hash(h), name(n) {}
+    GUIID(const char *s);
+    GUIID(const std::string &s);
+};
+
+template<GUIHash H> struct GUIConstHash { static const GUIHash value = H; };
+
+#define GUI_ID(s) GUIID(GUIConstHash<GUI_HashStr(s)>::value, s)
+
 struct PopupNode
 {
     std::string name;
@@ -79,6 +126,9 @@ struct GUISpinnerData
     std::string text_str;
 };
 
+/*
+ * The string is UTF-8. caret_pos and selection count characters, not bytes.
+ */
 struct GUIEditBoxData
 {
     int caret_pos;
@@ -92,10 +142,260 @@ struct GUIEditBoxData
     GUIEditBoxData(std::string *s);
 };
 
+/*
+ * Text for the multi-line editor, held in a gap buffer so typing only moves
+ * the bytes between the last edit and this one. The start of every line is
+ * kept in a second gap array split at the line being edited. Starts before
+ * that gap are offsets from the beginning of the text and starts after it are
+ * offsets from the end, so an edit only touches the lines it adds or removes.
+ */
+struct GUITextBuffer
+{
+    GUITextBuffer();
+    GUITextBuffer(const char *s, size_t len);
+
+    void assign(const char *s, size_t len);
+    void insert(size_t pos, const char *s, size_t len);
+    void erase(size_t pos, size_t len);
+
+    size_t size() const;
+    char at(size_t pos) const;
+    void copy(size_t pos, size_t len, std::string *out) const;
+    std::string str() const;
+
+    size_t lineCount() const;
+    size_t lineStart(size_t line) const;
+    size_t lineEnd(size_t line) const;  /* not including the newline */
+    size_t lineOf(size_t pos) const;
+
+private:
+    std::vector<char> text;
+    size_t gap, gap_len;
+
+    std::vector<size_t> lines;
+    size_t line_gap, line_gap_len;
+
+    void moveGap(size_t pos);
+    void reserveGap(size_t len);
+    void moveLineGap(size_t line);
+    void reserveLineGap(size_t n);
+};
+
+struct GUITextEditorData
+{
+    size_t caret;
+    size_t anchor;  /* other end of the selection */
+    int scroll;     /* first visible line */
+    float offset;
+    GUITextBuffer text;
+    GUITextBuffer *text_ptr;
+
+    GUITextEditorData();
+    GUITextEditorData(GUITextBuffer *t);
+};
+
+/*
+ * Log lines kept in a ring inside one byte arena, so memory stays bounded no
+ * matter how long the log runs. The oldest lines are dropped to make room.
+ * Each line is contiguous in the arena. A line that doesn't fit before the
+ * end of the arena starts again at the front.
+ *
+ * append() is O(1) amortized and locks mutex, so another thread can feed
+ * the log while the GUI draws it. Anything else reading the log while
+ * another thread appends must hold mutex too. Rows count from the oldest
+ * line still kept; first() is the number of lines dropped before it.
+ */
+struct GUILog
+{
+    sf::Mutex mutex;
+
+    GUILog(size_t arena_bytes = 1 << 20, size_t max_lines = 1 << 16);
+
+    void append(const char *s, size_t len);  /* one line per '\n' */
+    void append(const std::string &s);
+    void clear();
+
+    size_t lineCount() const;
+    size_t first() const;
+    const char *line(size_t row, size_t *len) const;
+
+private:
+    struct Line
+    {
+        size_t offset, len;
+        size_t next_filled;     /* slot of the next line holding bytes */
+    };
+
+    std::vector<char> arena;
+    size_t write;
+
+    std::vector<Line> lines;
+    size_t head, count;
+    size_t dropped;
+
+    /* lines holding bytes, linked oldest to newest */
+    size_t filled, oldest_filled, newest_filled;
+
+    void appendLine(const char *s, size_t len);
+    void dropOldest();
+};
+
+/*
+ * A text file mapped read only, with an index of where its lines start. The
+ * index is built in the background by worker threads that each scan a chunk
+ * of the file for newlines. Lines in the leading run of finished chunks can
+ * be read while the rest is still being indexed. Starts are kept as 32 bit
+ * offsets into their chunk, and scanned chunks are dropped from memory again,
+ * so resident memory stays near the size of the index.
+ *
+ * Lines are read straight from the mapping and aren't null terminated.
+ */
+struct GUIMappedFile
+{
+    GUIMappedFile();
+    ~GUIMappedFile();
+
+    bool open(const std::string &path, int threads = 2);
+    void close();
+
+    bool isOpen() const;
+    bool indexed();
+    float progress();
+    size_t lineCount();
+    const char *line(size_t row, size_t *len);
+
+private:
+    struct Chunk
+    {
+        size_t begin, end;
+        size_t first;   /* number of the line starting at starts[0] */
+        std::vector<unsigned int> starts;
+        bool done;
+    };
+
+    const char *data;
+    size_t length;
+    bool is_open;
+
+    std::vector<Chunk> chunks;
+    size_t next_chunk;
+    size_t ready;        /* chunks [0, ready) are done */
+    size_t ready_lines;  /* lines starting in them, plus line 0 */
+    size_t scanned;
+    bool cancel;
+
+    std::vector<sf::Thread*> workers;
+    sf::Mutex mutex;
+
+    static void worker(void *p);
+    size_t lineStart(size_t row) const;
+};
+
+/*
+ * Strings packed one after another into a single char arena, with an array
+ * of where each starts. A table of n strings is two allocations instead of
+ * n, and rows sit next to each other in memory. Strings are null terminated.
+ * clear() keeps the memory for reuse. generation() changes whenever the
+ * contents do, so anything built from a table can tell when it is stale.
+ */
+struct GUIStringTable
+{
+    GUIStringTable();
+
+    void add(const char *s, size_t len);
+    void add(const std::string &s);
+    void append(const char *s, size_t len, char separator);  /* one string per separated field */
+    void append(const GUIStringTable &t);
+    void reserve(size_t strings, size_t chars);  /* room for this many more */
+    void clear();
+
+    size_t size() const;
+    bool empty() const;
+    const char *operator[](size_t i) const;
+    size_t length(size_t i) const;
+    unsigned int generation() const;
+
+private:
+    std::vector<char> chars;
+    std::vector<unsigned int> offsets;  /* start of each string and the end */
+    unsigned int gen;
+};
+
+/*
+ * Selected rows of a list of count() rows, kept as a sorted set of disjoint
+ * [begin, end) ranges instead of a flag per row. Lookups are O(log n) in the
+ * number of ranges and editing a range is O(log n) amortized. Invert and
+ * select all only flip whether the ranges hold the selected or unselected
+ * rows. anchor is the row that shift-clicks select from.
+ *
+ * To visit the selected rows a range at a time:
+ *
+ *     for(int b = s.nextSelected(0); b < s.count(); b = s.nextSelected(b))
+ *     {
+ *         for(int e = s.rangeEnd(b); b < e; b++)
+ *             ...
+ *     }
+ */
+struct GUISelection
+{
+    int anchor;
+
+    GUISelection(int count = 0);
+
+    void resize(int count);
+    int count() const;
+
+    bool isSelected(int row) const;
+    bool empty() const;
+    int nextSelected(int row) const;  /* first selected row from row on, or count() */
+    int rangeEnd(int row) const;      /* end of the selected run holding row */
+
+    void select(int begin, int end, bool selected = true);
+    void toggle(int row);
+    void selectAll();
+    void clear();
+    void invert();
+
+private:
+    std::map<int, int> ranges;  /* begin -> end */
+    bool inverted;
+    int rows;
+
+    bool rangesContain(int row) const;
+    void rangesAdd(int begin, int end);
+    void rangesRemove(int begin, int end);
+};
+
+/*
+ * Heights of a list of count() rows, for listboxes whose rows aren't all the
+ * same height. A Fenwick tree over the heights makes the y of a row and the
+ * row at a y O(log n), and changing a height or adding rows at the end costs
+ * O(log n) per row. Sums are kept in doubles so millions of rows still add
+ * up exactly to the pixel.
+ */
+struct GUIRowHeights
+{
+    GUIRowHeights();
+
+    void assign(int count, float height);
+    void resize(int count, float height);   /* new rows get height */
+    void set(int row, float height);
+
+    int count() const;
+    float height(int row) const;
+    double rowY(int row) const;     /* sum of the heights above row */
+    double total() const;
+    int rowAt(double y) const;      /* row covering y, clamped to the rows */
+
+private:
+    std::vector<float> heights;
+    std::vector<double> tree;       /* tree[i] sums rows [i - lowbit(i), i) */
+};
+
 struct GUIDirContents
 {
-    std::vector<std::string> names, types, sizes, dirfile;
-    std::vector<bool> selected;
+    GUIStringTable names, types, sizes, dirfile;
+    GUISelection selected;
 
     void add(const std::string &name, const std::string type, const std::string size, bool is_file);
     void clear();
@@ -141,10 +441,56 @@ public:
     bool            intersects(const GUI_AABB &o) const;
     bool            intersects(float x1, float y1, float x2, float y2) const;
     GUI_AABB        intersection(const GUI_AABB &o) const;
+    bool            isEmpty() const;
     float           getWidth() const;
     float           getHeight() const;
 };
 
+struct GUIInputStats
+{
+    size_t queued;      /* events given to GUI_Queue* */
+    size_t coalesced;   /* events merged into the previous queued event */
+    size_t processed;   /* events run through the event and response passes */
+};
+
+struct GUIRedrawStats
+{
+    size_t frames;      /* draw passes run */
+    size_t unchanged;   /* draw passes whose commands matched the previous frame */
+    size_t skipped;     /* frames GUI_NeedsRedraw() said could be skipped */
+};
+
+struct GUIDamageStats
+{
+    size_t frames;          /* draw passes measured */
+    size_t rects;           /* dirty rects in the last frame */
+    float  dirty_percent;   /* percent of the window the last frame dirtied */
+    float  average_percent; /* mean of dirty_percent over all frames */
+};
+
+struct GUIRenderStats
+{
+    size_t draw_calls;  /* batches submitted in the last frame */
+    size_t vertices;    /* vertices submitted in the last frame */
+};
+
+struct GUITextCacheStats
+{
+    size_t capacity;    /* most strings the cache holds */
+    size_t count;       /* strings in the cache */
+    size_t hits;
+    size_t misses;
+    size_t evictions;
+};
+
+struct GUIStateStats
+{
+    size_t capacity;    /* slots in the state table */
+    size_t count;       /* live entries */
+    size_t evictions;   /* entries destroyed for not being used since GUI_Init */
+    size_t pool_bytes;  /* memory held by the state pool allocator */
+};
+
 struct GUIFont
 {
     sf::Font *sf_font;
@@ -179,6 +525,88 @@ void GUI_MouseWheel(int delta);
 void GUI_KeyPressed(sf::Key::Code key, bool control, bool alt, bool shift);
 void GUI_KeyTyped(int key);
 
+/*
+ * A run of UTF-8 text, such as a paste, that the active edit box inserts in
+ * one go.
+ */
+void GUI_TextInput(const char *text, size_t len);
+
+/*
+ * With the hover index on, GUI_MouseMove() finds the hot widget using the
+ * rectangles recorded by the last draw pass, and GUI_HoverResolved() is true
+ * when it did so the event pass for the move can be skipped. Only plain
+ * moves are resolved, not drags. It's off by default, since a custom widget
+ * that only hot tests in the event pass isn't in the index and would never
+ * become hot on a plain move. Turn it on once every widget hot tests in the
+ * draw pass too (see GUI_GenericHotActive()).
+ */
+void GUI_HoverIndex(bool enable);
+bool GUI_HoverResolved();
+
+/*
+ * Queued input. Consecutive mouse moves, wheel deltas and typed text are
+ * merged while queued. Presses of printable keys without control or alt are
+ * dropped, since the text they type follows them. GUI_ProcessInput() feeds at
+ * most max_events of the queued events through do_pass(GUI_PASS_EVENT) and
+ * do_pass(GUI_PASS_RESPONSE), leaving the rest for the next call. The event
+ * pass is skipped for moves that GUI_HoverResolved().
+ */
+void          GUI_QueueMouseButton(sf::Mouse::Button button, bool down);
+void          GUI_QueueMouseMove(float x, float y);
+void          GUI_QueueMouseWheel(int delta);
+void          GUI_QueueKeyPressed(sf::Key::Code key, bool control, bool alt, bool shift);
+void          GUI_QueueKeyTyped(int key);
+void          GUI_QueueTextInput(const char *text, size_t len);
+int           GUI_ProcessInput(void (*do_pass)(int pass), int max_events);
+GUIInputStats GUI_GetInputStats();
+
+/*
+ * Idle detection. GUI_NeedsRedraw() returns false when no input has arrived
+ * since the last draw pass and that pass drew exactly what the one before it
+ * did, in which case the host can skip the draw pass and sleep. Anything that
+ * changes what the GUI shows without input (timers, values changed by other
+ * code, the window being exposed) needs GUI_RequestRedraw().
+ */
+bool           GUI_NeedsRedraw();
+void           GUI_RequestRedraw();
+GUIRedrawStats GUI_GetRedrawStats();
+
+/*
+ * The screen space rectangles (top left origin) that differ between the last
+ * two draw passes. A backend that keeps the previous frame around only needs
+ * to redraw these.
+ */
+const std::vector<GUI_AABB>& GUI_GetDamageRects();
+GUIDamageStats                GUI_GetDamageStats();
+GUIRenderStats                GUI_GetRenderStats();
+
+/*
+ * Text measurements are cached by font, size and string. The cache holds at
+ * most the given number of strings, dropping the least recently used.
+ */
+void              GUI_TextCacheSize(int entries);
+GUITextCacheStats GUI_GetTextCacheStats();
+
+/*
+ * Glyphs and measurements are cached by the font's address. Before a font is
+ * freed or reloaded, GUI_ForgetFont() drops everything cached for it so a
+ * later font at the same address isn't measured with stale glyphs.
+ * GUI_ForgetFonts() drops every font and frees the glyph tables, for
+ * shutdown.
+ */
+void GUI_ForgetFont(const sf::Font *font);
+void GUI_ForgetFonts();
+
+
+
+/*--------------------------------------------------------------------------*
+ * Id Scopes                                                                *
+ *--------------------------------------------------------------------------*/
+void  GUI_PushID(GUIID id);
+void  GUI_PopID();
+GUIID GUI_ScopedID(const char *suffix);
+GUIID GUI_ScopedID(int index);
+
 
 
 /*--------------------------------------------------------------------------*
@@ -202,23 +630,29 @@ void GUI_PopTranslation();
 /*--------------------------------------------------------------------------*
  * Grouping                                                                 *
  *--------------------------------------------------------------------------*/
-void GUI_BeginGroup(float x, float y, float w, float h);
+/*
+ * Nested groups clip to each other. GUI_BeginGroup() returns false when the
+ * group is completely clipped so the caller can skip its contents. The group
+ * must still be ended either way.
+ */
+bool GUI_BeginGroup(float x, float y, float w, float h);
 void GUI_EndGroup();
+bool GUI_IsVisible(float x, float y, float w, float h);
 
 
 
 /*--------------------------------------------------------------------------*
  * Labels                                                                   *
  *--------------------------------------------------------------------------*/
-void GUI_Label(const std::string &id, int x, int y, int w, int h, const std::string &str);
+void GUI_Label(GUIID id, int x, int y, int w, int h, const std::string &str);
 
 
 
 /*--------------------------------------------------------------------------*
  * Buttons                                                                  *
  *--------------------------------------------------------------------------*/
-bool GUI_Button(const std::string &id, int x, int y, int w, int h, const std::string &str);
-bool GUI_ToggleButton(const std::string &id, int x, int y, int w, int h, const std::string &str, bool *value);
+bool GUI_Button(GUIID id, int x, int y, int w, int h, const std::string &str);
+bool GUI_ToggleButton(GUIID id, int x, int y, int w, int h, const std::string &str, bool *value);
 void GUI_ButtonMode(int mode);
 void GUI_PushButtonMode();
 void GUI_PopButtonMode();
@@ -228,15 +662,16 @@ void GUI_PopButtonMode();
 /*--------------------------------------------------------------------------*
  * Checkboxes                                                               *
  *--------------------------------------------------------------------------*/
-bool GUI_Checkbox(const std::string &id, float x, float y, float w, float h, bool *value);
-bool GUI_CheckboxLabelled(const std::string id, float x, float y, float w, float h, const std::string &label, bool *value);
+bool GUI_Checkbox(GUIID id, float x, float y, float w, float h, bool *value);
+bool GUI_CheckboxLabelled(GUIID id, float x, float y, float w, float h, const std::string &label, bool *value);
 
 
 /*--------------------------------------------------------------------------*
  * Slider/Scrollbar                                                         *
  *--------------------------------------------------------------------------*/
-bool GUI_Slider(const std::string &id, float x, float y, float w, float h, int type, int min, int max, int page_size, int *value);
-bool GUI_Scrollbar(const std::string &id, float x, float y, float w, float h, int type, int min, int max, int page_size, int *value);
+bool GUI_Slider(GUIID id, float x, float y, float w, float h, int type, int min, int max, int page_size, int *value);
+bool GUI_Scrollbar(GUIID id, float x, float y, float w, float h, int type, int min, int max, int page_size, int *value);
+bool GUI_Scrollbar(GUIID id, float x, float y, float w, float h, int type, int min, int max, int page_size, int *value, int step);
 void GUI_ThumbSize();
 
 
@@ -244,17 +679,40 @@ void GUI_ThumbSize();
 /*--------------------------------------------------------------------------*
  * Listboxes                                                                *
  *--------------------------------------------------------------------------*/
-bool GUI_Listbox(const std::string &id, float x, float y, float w, float h, const std::vector<std::string> &data, int data_offset, int *choice);
-bool GUI_ListboxMulti(const std::string &id, float x, float y, float w, float h, const std::vector<std::string> &data, int data_offset, std::vector<bool> *selected);
-bool GUI_ScrolledListbox(const std::string &id, float x, float y, float w, float h, const std::vector<std::string> &data, int *choice, cml::vector2i *scroll);
-bool GUI_ScrolledListboxMulti(const std::string &id, float x, float y, float w, float h, const std::vector<std::string> &data, std::vector<bool> *selected, cml::vector2i *scroll);
+/*
+ * Supplies the text of a row to the listbox overloads that take a row count.
+ * It's called for the rows in view, and for every row when typing into a
+ * list builds its search index. The string only has to stay valid until the
+ * next call.
+ */
+typedef const char *(*GUIRowText)(int row, void *user);
+
+bool GUI_Listbox(GUIID id, float x, float y, float w, float h, const std::vector<std::string> &data, int data_offset, int *choice);
+bool GUI_ListboxMulti(GUIID id, float x, float y, float w, float h, const std::vector<std::string> &data, int data_offset, GUISelection *selected);
+bool GUI_ScrolledListbox(GUIID id, float x, float y, float w, float h, const std::vector<std::string> &data, int *choice, cml::vector2i *scroll);
+bool GUI_ScrolledListbox(GUIID id, float x, float y, float w, float h, const std::vector<std::string> &data, int *choice);
+bool GUI_ScrolledListboxMulti(GUIID id, float x, float y, float w, float h, const std::vector<std::string> &data, GUISelection *selected, cml::vector2i *scroll);
+
+bool GUI_Listbox(GUIID id, float x, float y, float w, float h, int count, GUIRowText text, void *user, int data_offset, int *choice);
+bool GUI_ListboxMulti(GUIID id, float x, float y, float w, float h, int count, GUIRowText text, void *user, int data_offset, GUISelection *selected);
+bool GUI_ScrolledListbox(GUIID id, float x, float y, float w, float h, int count, GUIRowText text, void *user, int *choice, cml::vector2i *scroll);
+bool GUI_ScrolledListbox(GUIID id, float x, float y, float w, float h, int count, GUIRowText text, void *user, int *choice);
+bool GUI_ScrolledListboxMulti(GUIID id, float x, float y, float w, float h, int count, GUIRowText text, void *user, GUISelection *selected, cml::vector2i *scroll);
+bool GUI_ScrolledListbox(GUIID id, float x, float y, float w, float h, int count, GUIRowText text, void *user, GUIRowHeights *heights, int *choice, int *scroll);
+bool GUI_ScrolledListbox(GUIID id, float x, float y, float w, float h, int count, GUIRowText text, void *user, GUIRowHeights *heights, int *choice);
+
+bool GUI_Listbox(GUIID id, float x, float y, float w, float h, const GUIStringTable &data, int data_offset, int *choice);
+bool GUI_ListboxMulti(GUIID id, float x, float y, float w, float h, const GUIStringTable &data, int data_offset, GUISelection *selected);
+bool GUI_ScrolledListbox(GUIID id, float x, float y, float w, float h, const GUIStringTable &data, int *choice, cml::vector2i *scroll);
+bool GUI_ScrolledListbox(GUIID id, float x, float y, float w, float h, const GUIStringTable &data, int *choice);
+bool GUI_ScrolledListboxMulti(GUIID id, float x, float y, float w, float h, const GUIStringTable &data, GUISelection *selected, cml::vector2i *scroll);
 
 
 
 /*--------------------------------------------------------------------------*
  * Scroll Area                                                              *
  *--------------------------------------------------------------------------*/
-void GUI_BeginScrollArea(const std::string &id, float x, float y, float w, float h, float scroll_size, int min_scroll_x, int max_scroll_x, int min_scroll_y, int max_scroll_y, cml::vector2i *scroll);
+bool GUI_BeginScrollArea(GUIID id, float x, float y, float w, float h, float scroll_size, int min_scroll_x, int max_scroll_x, int min_scroll_y, int max_scroll_y, cml::vector2i *scroll);
 void GUI_EndScrollArea();
 
 
@@ -262,7 +720,7 @@ void GUI_EndScrollArea();
 /*--------------------------------------------------------------------------*
  * Window                                                                   *
  *--------------------------------------------------------------------------*/
-void GUI_BeginWindow(const std::string &id, float *x, float *y, float w, float h, const std::string &title);
+bool GUI_BeginWindow(GUIID id, float *x, float *y, float w, float h, const std::string &title);
 void GUI_EndWindow();
 
 
@@ -270,7 +728,7 @@ void GUI_EndWindow();
 /*--------------------------------------------------------------------------*
  * Dropdown Menu                                                            *
  *--------------------------------------------------------------------------*/
-bool GUI_BeginDropMenu(const std::string &id, float x, float y, float w, float h, float item_width, PopupNode *root);
+bool GUI_BeginDropMenu(GUIID id, float x, float y, float w, float h, float item_width, PopupNode *root);
 void GUI_EndDropMenu();
 
 
@@ -281,11 +739,11 @@ void GUI_EndDropMenu();
 void GUI_BeginPopupGroup(PopupNode *root);
 void GUI_EndPopupGroup();
 
-void GUI_BeginPopupMenu(const std::string &id, float x, float y, float w, float h, float item_h, PopupNode *root);
+void GUI_BeginPopupMenu(GUIID id, float x, float y, float w, float h, float item_h, PopupNode *root);
 void GUI_EndPopupMenu();
 
-bool GUI_PopupMenuButton(const std::string &id, const std::string &left_str, const std::string &right_str);
-void GUI_PopupSubMenuButton(const std::string &id, PopupNode *node);
+bool GUI_PopupMenuButton(GUIID id, const std::string &left_str, const std::string &right_str);
+void GUI_PopupSubMenuButton(GUIID id, PopupNode *node);
 void GUI_PopupSeparator(float h);
 
 
@@ -293,15 +751,49 @@ void GUI_PopupSeparator(float h);
 /*--------------------------------------------------------------------------*
  * Text Editing                                                             *
  *--------------------------------------------------------------------------*/
-bool GUI_EditBox(const std::string &id, float x, float y, float w, float h, int *caret_pos, int *selection, float *offset, std::string *str); //FIXME get rid of this one
-bool GUI_EditBox(const std::string &id, float x, float y, float w, float h, GUIEditBoxData *data);
+bool GUI_EditBox(GUIID id, float x, float y, float w, float h, int *caret_pos, int *selection, float *offset, std::string *str); //FIXME get rid of this one
+bool GUI_EditBox(GUIID id, float x, float y, float w, float h, GUIEditBoxData *data);
+bool GUI_EditBox(GUIID id, float x, float y, float w, float h, std::string *str);
+
+/*
+ * Multi-line editor. Only the lines in view are measured and drawn, so the
+ * cost of a frame depends on the size of the widget rather than the text.
+ */
+bool GUI_TextEditor(GUIID id, float x, float y, float w, float h, GUITextEditorData *data);
+bool GUI_TextEditor(GUIID id, float x, float y, float w, float h, GUITextBuffer *text);
+
+
+
+/*--------------------------------------------------------------------------*
+ * Log Console                                                              *
+ *--------------------------------------------------------------------------*/
+/*
+ * Shows the tail of the log and keeps following it until scrolled away from
+ * the bottom. Only the rows in view are drawn. Lines appended from another
+ * thread don't count as input, so a host that skips frames while
+ * GUI_NeedsRedraw() is false should call GUI_RequestRedraw() when they
+ * arrive.
+ */
+bool GUI_LogConsole(GUIID id, float x, float y, float w, float h, GUILog *log);
+
+
+
+/*--------------------------------------------------------------------------*
+ * File Viewer                                                              *
+ *--------------------------------------------------------------------------*/
+/*
+ * Shows the lines of a mapped file, drawing only the rows in view. While the
+ * file is still being indexed a progress bar runs along the bottom and the
+ * lines indexed so far can be scrolled.
+ */
+bool GUI_FileViewer(GUIID id, float x, float y, float w, float h, GUIMappedFile *file);
 
 
 
 /*--------------------------------------------------------------------------*
  * File Dialog                                                              *
  *--------------------------------------------------------------------------*/
-bool GUI_FileChooser(const std::string &id, float x, float y, float w, float h, GUIFileChooserData *data);
+bool GUI_FileChooser(GUIID id, float x, float y, float w, float h, GUIFileChooserData *data);
 
 
 
@@ -317,16 +809,27 @@ void GUI_Font(sf::Font *sf_font, int size, const cml::vector4f &color);
 void GUI_FrameType();
 void GUI_Frame(float x, float y, float w, float h);
 
-void GUI_BeginFrame(float x, float y, float w, float h, float padding_x, float padding_y);
+bool GUI_BeginFrame(float x, float y, float w, float h, float padding_x, float padding_y);
 void GUI_EndFrame();
 
-bool GUI_DropList(const std::string &id, float x, float y, float w, float h, const std::vector<std::string> &data, int *choice, bool *open);
+bool GUI_DropList(GUIID id, float x, float y, float w, float h, const std::vector<std::string> &data, int *choice, bool *open);
+bool GUI_DropList(GUIID id, float x, float y, float w, float h, const GUIStringTable &data, int *choice, bool *open);
+bool GUI_DropList(GUIID id, float x, float y, float w, float h, int count, GUIRowText text, void *user, int *choice, bool *open);
 
 bool GUI_Event(int mask);
 bool GUI_IsMouseIn();
 
 template<class T> GUISpinnerData GUI_CreateSpinnerData(T value);
-template<class T> bool GUI_Spinner(const std::string &id, float x, float y, float w, float h, GUISpinnerData *data, T min, T max, T *value);
+template<class T> bool GUI_Spinner(GUIID id, float x, float y, float w, float h, GUISpinnerData *data, T min, T max, T *value);
+template<class T> bool GUI_Spinner(GUIID id, float x, float y, float w, float h, T min, T max, T *value);
+
+
+
+/*--------------------------------------------------------------------------*
+ * Widget State                                                             *
+ *--------------------------------------------------------------------------*/
+void          GUI_StateMaxAge(int frames);
+GUIStateStats GUI_GetStateStats();
 
 
 
@@ -334,9 +837,17 @@ template<class T> bool GUI_Spinner(const std::string &id, float x, float y, floa
  * Extending                                                                *
  *--------------------------------------------------------------------------*/
 int         GUI_GetPass();
-void        GUI_GenericHotActive(const std::string &id, float x, float y, float w, float h);
+
+/*
+ * Custom widgets should call this in the draw pass as well as the event pass
+ * so the widget is in the hit index used by GUI_HoverIndex().
+ */
+void        GUI_GenericHotActive(GUIID id, float x, float y, float w, float h);
+GUIHash     GUI_HotWidgetID();
+GUIHash     GUI_ActiveWidgetID();
 std::string GUI_HotWidget();
 std::string GUI_ActiveWidget();
+void        GUI_DebugNames(bool enable);
 bool        GUI_MouseLeftJustPressed();
 bool        GUI_MouseLeftDown();
 bool        GUI_MouseRightDown();
@@ -0,0 +1,764 @@
+#include <string.h>
+#include <limits.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+
+#include <cml/cml.h>
+#include <SFML/Window.hpp>
+#include <SFML/Graphics.hpp>
+
+#include "gui.h"
+
+
+/*--------------------------------------------------------------------------*
+ *
+ * Text buffer. text holds size() bytes with gap_len unused bytes starting at
+ * gap. lines holds lineCount() starts with line_gap_len unused entries
+ * starting at line_gap. Line 0 always starts at 0 so line_gap is at least 1.
+ *
+ *--------------------------------------------------------------------------*/
+GUITextBuffer::GUITextBuffer()
+{
+    assign("", 0);
+}
+
+GUITextBuffer::GUITextBuffer(const char *s, size_t len)
+{
+    assign(s, len);
+}
+
+void GUITextBuffer::assign(const char *s, size_t len)
+{
+    text.assign(s, s + len);
+    gap = len;
+    gap_len = 0;
+
+    lines.clear();
+    lines.push_back(0);
+
+    for(size_t i = 0; i < len; i++)
+        if(s[i] == '\n')
+            lines.push_back(i + 1);
+
+    line_gap = lines.size();
+    line_gap_len = 0;
+}
+
+size_t GUITextBuffer::size() const
+{
+    return text.size() - gap_len;
+}
+
+char GUITextBuffer::at(size_t pos) const
+{
+    return pos < gap ? text[pos] : text[pos + gap_len];
+}
+
+void GUITextBuffer::copy(size_t pos, size_t len, std::string *out) const
+{
+    out->clear();
+
+    if(pos < gap)
+    {
+        size_t n = std::min(len, gap - pos);
+        out->append(text.data() + pos, n);
+        pos += n;
+        len -= n;
+    }
+
+    if(len > 0)
+        out->append(text.data() + pos + gap_len, len);
+}
+
+std::string GUITextBuffer::str() const
+{
+    std::string s;
+    copy(0, size(), &s);
+    return s;
+}
+
+size_t GUITextBuffer::lineCount() const
+{
+    return lines.size() - line_gap_len;
+}
+
+size_t GUITextBuffer::lineStart(size_t line) const
+{
+    return line < line_gap ? lines[line] : size() - lines[line + line_gap_len];
+}
+
+size_t GUITextBuffer::lineEnd(size_t line) const
+{
+    return line + 1 < lineCount() ? lineStart(line + 1) - 1 : size();
+}
+
+size_t GUITextBuffer::lineOf(size_t pos) const
+{
+    size_t count = lineCount();
+
+    /* edits usually stay on the line just before the gap */
+    size_t l = line_gap - 1;
+    if(lineStart(l) <= pos && (l + 1 == count || pos < lineStart(l + 1)))
+        return l;
+
+    /* last line starting at or before pos */
+    size_t lo = 0, hi = count;
+
+    while(hi - lo > 1)
+    {
+        size_t mid = (lo + hi) / 2;
+
+        if(lineStart(mid) <= pos)
+            lo = mid;
+        else
+            hi = mid;
+    }
+
+    return lo;
+}
+
+void GUITextBuffer::moveGap(size_t pos)
+{
+    char *p = text.data();
+
+    if(pos < gap)
+        memmove(p + pos + gap_len, p + pos, gap - pos);
+    else if(pos > gap)
+        memmove(p + gap, p + gap + gap_len, pos - gap);
+
+    gap = pos;
+}
+
+void GUITextBuffer::reserveGap(size_t len)
+{
+    if(gap_len >= len)
+        return;
+
+    size_t used = size();
+    size_t after = text.size() - gap - gap_len;
+    size_t cap = std::max(text.size() * 2, used + len + 64);
+
+    text.resize(cap);
+
+    char *p = text.data();
+    memmove(p + cap - after, p + gap + gap_len, after);
+    gap_len = cap - used;
+}
+
+/* moves the line gap so lines [0, line) start from the beginning */
+void GUITextBuffer::moveLineGap(size_t line)
+{
+    size_t len = size();
+
+    while(line_gap > line)
+    {
+        line_gap--;
+        lines[line_gap + line_gap_len] = len - lines[line_gap];
+    }
+
+    while(line_gap < line)
+    {
+        lines[line_gap] = len - lines[line_gap + line_gap_len];
+        line_gap++;
+    }
+}
+
+void GUITextBuffer::reserveLineGap(size_t n)
+{
+    if(line_gap_len >= n)
+        return;
+
+    size_t count = lineCount();
+    size_t after = lines.size() - line_gap - line_gap_len;
+    size_t cap = std::max(lines.size() * 2, count + n + 16);
+
+    lines.resize(cap);
+    std::copy_backward(lines.begin() + line_gap + line_gap_len, lines.begin() + line_gap + line_gap_len + after, lines.end());
+    line_gap_len = cap - count;
+}
+
+void GUITextBuffer::insert(size_t pos, const char *s, size_t len)
+{
+    if(len == 0)
+        return;
+
+    /* starts after pos are offsets from the end and don't change */
+    moveLineGap(lineOf(pos) + 1);
+    reserveLineGap(std::count(s, s + len, '\n'));
+
+    for(size_t i = 0; i < len; i++)
+    {
+        if(s[i] == '\n')
+        {
+            lines[line_gap++] = pos + i + 1;
+            line_gap_len--;
+        }
+    }
+
+    moveGap(pos);
+    reserveGap(len);
+    memcpy(text.data() + gap, s, len);
+    gap += len;
+    gap_len -= len;
+}
+
+void GUITextBuffer::erase(size_t pos, size_t len)
+{
+    if(len == 0)
+        return;
+
+    moveLineGap(lineOf(pos) + 1);
+
+    /* drop the lines whose newline is erased */
+    size_t total = size();
+
+    while(line_gap + line_gap_len < lines.size() && total - lines[line_gap + line_gap_len] <= pos + len)
+        line_gap_len++;
+
+    moveGap(pos);
+    gap_len += len;
+}
+
+
+
+/*--------------------------------------------------------------------------*
+ *
+ * Log ring. lines is a ring of count entries starting at head, oldest first.
+ * Line bytes are written at write, which only moves forward and wraps to the
+ * front of the arena. The oldest line holding bytes is always the first one
+ * at or after write, so making room only ever drops lines from the front of
+ * the ring. Empty lines hold no bytes and only go along with the next line
+ * that does, or when the ring is full. The lines holding bytes are linked so
+ * the oldest one is found without stepping over the empty ones.
+ *
+ *--------------------------------------------------------------------------*/
+GUILog::GUILog(size_t arena_bytes, size_t max_lines)
+{
+    arena.resize(std::max(arena_bytes, size_t(1)));
+    lines.resize(std::max(max_lines, size_t(1)));
+    write = 0;
+    head = count = 0;
+    dropped = 0;
+    filled = oldest_filled = newest_filled = 0;
+}
+
+void GUILog::append(const char *s, size_t len)
+{
+    sf::Lock lock(mutex);
+
+    const char *end = s + len;
+
+    for(;;)
+    {
+        const char *nl = std::find(s, end, '\n');
+        appendLine(s, nl - s);
+
+        if(nl == end || nl + 1 == end)
+            break;
+
+        s = nl + 1;
+    }
+}
+
+void GUILog::append(const std::string &s)
+{
+    append(s.data(), s.size());
+}
+
+void GUILog::clear()
+{
+    sf::Lock lock(mutex);
+
+    dropped += count;
+    write = 0;
+    head = count = 0;
+    filled = 0;
+}
+
+size_t GUILog::lineCount() const
+{
+    return count;
+}
+
+size_t GUILog::first() const
+{
+    return dropped;
+}
+
+const char *GUILog::line(size_t row, size_t *len) const
+{
+    const Line &l = lines[(head + row) % lines.size()];
+    *len = l.len;
+    return arena.data() + l.offset;
+}
+
+void GUILog::dropOldest()
+{
+    if(filled > 0 && oldest_filled == head)
+    {
+        oldest_filled = lines[head].next_filled;
+        filled--;
+    }
+
+    head = (head + 1) % lines.size();
+    count--;
+    dropped++;
+}
+
+void GUILog::appendLine(const char *s, size_t len)
+{
+    size_t size = arena.size();
+    len = std::min(len, size);
+
+    /* bytes about to be used, counting the end of the arena skipped on a wrap */
+    size_t pos = write;
+    size_t span = len;
+
+    if(pos + len > size)
+    {
+        span += size - pos;
+        pos = 0;
+    }
+
+    while(count > 0)
+    {
+        if(count == lines.size())
+        {
+            dropOldest();
+            continue;
+        }
+
+        /*
+         * empty lines hold no bytes, so the oldest line that has some decides.
+         * Lines only leave from the front, so the empty ones before it go too.
+         */
+        if(filled == 0 || (lines[oldest_filled].offset + size - write) % size >= span)
+            break;
+
+        dropOldest();
+    }
+
+    memcpy(arena.data() + pos, s, len);
+    write = pos + len;
+
+    size_t slot = (head + count) % lines.size();
+    Line &l = lines[slot];
+    l.offset = pos;
+    l.len = len;
+    count++;
+
+    if(len > 0)
+    {
+        if(filled > 0)
+            lines[newest_filled].next_filled = slot;
+        else
+            oldest_filled = slot;
+
+        newest_filled = slot;
+        filled++;
+    }
+}
+
+
+
+/*--------------------------------------------------------------------------*
+ *
+ * String table. String i is chars[offsets[i]] up to its null terminator,
+ * and offsets has one more entry than there are strings.
+ *
+ *--------------------------------------------------------------------------*/
+GUIStringTable::GUIStringTable()
+{
+    offsets.push_back(0);
+    gen = 0;
+}
+
+void GUIStringTable::add(const char *s, size_t len)
+{
+    chars.insert(chars.end(), s, s + len);
+    chars.push_back('\0');
+    offsets.push_back(chars.size());
+    gen++;
+}
+
+void GUIStringTable::add(const std::string &s)
+{
+    add(s.data(), s.size());
+}
+
+void GUIStringTable::append(const char *s, size_t len, char separator)
+{
+    const char *end = s + len;
+
+    reserve(std::count(s, end, separator) + 1, len + 1);
+
+    while(s != end)
+    {
+        const char *sep = std::find(s, end, separator);
+
+        chars.insert(chars.end(), s, sep);
+        chars.push_back('\0');
+        offsets.push_back(chars.size());
+
+        s = sep == end ? end : sep + 1;
+    }
+
+    gen++;
+}
+
+void GUIStringTable::append(const GUIStringTable &t)
+{
+    unsigned int base = chars.size();
+
+    chars.insert(chars.end(), t.chars.begin(), t.chars.end());
+
+    for(size_t i = 1; i < t.offsets.size(); i++)
+        offsets.push_back(base + t.offsets[i]);
+
+    gen++;
+}
+
+/*
+ * vector::reserve allocates exactly what it's asked for, so growing by the
+ * amount wanted on every append would copy the whole arena each time.
+ */
+template<class T> static void reserveMore(std::vector<T> &v, size_t n)
+{
+    if(v.size() + n > v.capacity())
+        v.reserve(std::max(v.capacity() * 2, v.size() + n));
+}
+
+void GUIStringTable::reserve(size_t strings, size_t n)
+{
+    reserveMore(offsets, strings);
+    reserveMore(chars, n);
+}
+
+void GUIStringTable::clear()
+{
+    chars.clear();
+    offsets.resize(1);
+    gen++;
+}
+
+size_t GUIStringTable::size() const
+{
+    return offsets.size() - 1;
+}
+
+bool GUIStringTable::empty() const
+{
+    return offsets.size() == 1;
+}
+
+const char *GUIStringTable::operator[](size_t i) const
+{
+    return &chars[offsets[i]];
+}
+
+size_t GUIStringTable::length(size_t i) const
+{
+    return offsets[i+1] - offsets[i] - 1;
+}
+
+unsigned int GUIStringTable::generation() const
+{
+    return gen;
+}
+
+
+
+/*--------------------------------------------------------------------------*
+ *
+ * Selection. ranges are disjoint and never touch, since touching ranges are
+ * merged. With inverted set they hold the unselected rows instead. Rows past
+ * count() are always kept unselected so growing the list doesn't select
+ * anything.
+ *
+ *--------------------------------------------------------------------------*/
+GUISelection::GUISelection(int count)
+{
+    anchor = 0;
+    inverted = false;
+    rows = std::max(count, 0);
+}
+
+void GUISelection::resize(int count)
+{
+    rows = std::max(count, 0);
+
+    if(inverted)
+        rangesAdd(rows, INT_MAX);
+    else
+        rangesRemove(rows, INT_MAX);
+}
+
+int GUISelection::count() const
+{
+    return rows;
+}
+
+bool GUISelection::rangesContain(int row) const
+{
+    std::map<int, int>::const_iterator it = ranges.upper_bound(row);
+
+    if(it == ranges.begin())
+        return false;
+
+    --it;
+    return row < it->second;
+}
+
+void GUISelection::rangesAdd(int begin, int end)
+{
+    std::map<int, int>::iterator it = ranges.upper_bound(begin);
+
+    if(it != ranges.begin())
+    {
+        std::map<int, int>::iterator prev = it;
+        --prev;
+
+        if(prev->second >= begin)
+        {
+            begin = prev->first;
+            end = std::max(end, prev->second);
+            it = prev;
+        }
+    }
+
+    while(it != ranges.end() && it->first <= end)
+    {
+        end = std::max(end, it->second);
+        ranges.erase(it++);
+    }
+
+    ranges[begin] = end;
+}
+
+void GUISelection::rangesRemove(int begin, int end)
+{
+    std::map<int, int>::iterator it = ranges.upper_bound(begin);
+
+    if(it != ranges.begin())
+    {
+        std::map<int, int>::iterator prev = it;
+        --prev;
+
+        if(prev->second > begin)
+        {
+            if(prev->second > end)
+                ranges[end] = prev->second;
+
+            if(prev->first == begin)
+                ranges.erase(prev);
+            else
+                prev->second = begin;
+        }
+    }
+
+    while(it != ranges.end() && it->first < end)
+    {
+        if(it->second > end)
+            ranges[end] = it->second;
+
+        ranges.erase(it++);
+    }
+}
+
+bool GUISelection::isSelected(int row) const
+{
+    return 0 <= row && row < rows && rangesContain(row) != inverted;
+}
+
+bool GUISelection::empty() const
+{
+    return nextSelected(0) == rows;
+}
+
+int GUISelection::nextSelected(int row) const
+{
+    row = std::max(row, 0);
+
+    if(row >= rows)
+        return rows;
+
+    std::map<int, int>::const_iterator it = ranges.upper_bound(row);
+    std::map<int, int>::const_iterator prev = it;
+    bool in_range = it != ranges.begin() && row < (--prev)->second;
+
+    if(inverted)
+        return std::min(in_range ? prev->second : row, rows);
+
+    if(in_range)
+        return row;
+
+    return it == ranges.end() ? rows : std::min(it->first, rows);
+}
+
+int GUISelection::rangeEnd(int row) const
+{
+    std::map<int, int>::const_iterator it = ranges.upper_bound(row);
+
+    if(inverted)
+        return it == ranges.end() ? rows : std::min(it->first, rows);
+
+    --it;
+    return std::min(it->second, rows);
+}
+
+void GUISelection::select(int begin, int end, bool selected)
+{
+    begin = std::max(begin, 0);
+    end = std::min(end, rows);
+
+    if(begin >= end)
+        return;
+
+    if(selected != inverted)
+        rangesAdd(begin, end);
+    else
+        rangesRemove(begin, end);
+}
+
+void GUISelection::toggle(int row)
+{
+    select(row, row+1, !isSelected(row));
+}
+
+void GUISelection::selectAll()
+{
+    ranges.clear();
+    inverted = true;
+    rangesAdd(rows, INT_MAX);
+}
+
+void GUISelection::clear()
+{
+    ranges.clear();
+    inverted = false;
+}
+
+void GUISelection::invert()
+{
+    inverted = !inverted;
+
+    /* keep the rows past the end unselected */
+    if(inverted)
+        rangesAdd(rows, INT_MAX);
+    else
+        rangesRemove(rows, INT_MAX);
+}
+
+
+
+/*--------------------------------------------------------------------------*
+ *
+ * Row heights. tree is 1-based: tree[i] holds the sum of the lowbit(i) rows
+ * ending at row i-1. A node only covers rows before it, so rows can be
+ * dropped from or added to the end without touching the nodes before them.
+ *
+ *--------------------------------------------------------------------------*/
+GUIRowHeights::GUIRowHeights()
+{
+    tree.push_back(0.0);
+}
+
+void GUIRowHeights::assign(int count, float height)
+{
+    heights.clear();
+    tree.resize(1);
+    resize(count, height);
+}
+
+void GUIRowHeights::resize(int count, float height)
+{
+    count = std::max(count, 0);
+
+    if(count <= (int)heights.size())
+    {
+        heights.resize(count);
+        tree.resize(count + 1);
+        return;
+    }
+
+    heights.reserve(count);
+    tree.reserve(count + 1);
+
+    while((int)heights.size() < count)
+    {
+        /* new node i covers row i-1 and the lowbit(i)-1 rows before it */
+        int i = heights.size() + 1;
+        double sum = height;
+
+        for(int j = i - 1; j > i - (i & -i); j -= j & -j)
+            sum += tree[j];
+
+        heights.push_back(height);
+        tree.push_back(sum);
+    }
+}
+
+void GUIRowHeights::set(int row, float height)
+{
+    if(row < 0 || row >= (int)heights.size())
+        return;
+
+    double delta = (double)height - heights[row];
+    heights[row] = height;
+
+    for(size_t i = row + 1; i < tree.size(); i += i & -i)
+        tree[i] += delta;
+}
+
+int GUIRowHeights::count() const
+{
+    return heights.size();
+}
+
+float GUIRowHeights::height(int row) const
+{
+    return heights[row];
+}
+
+double GUIRowHeights::rowY(int row) const
+{
+    double y = 0.0;
+
+    for(int i = std::min(row, (int)heights.size()); i > 0; i -= i & -i)
+        y += tree[i];
+
+    return y;
+}
+
+double GUIRowHeights::total() const
+{
+    return rowY(heights.size());
+}
+
+int GUIRowHeights::rowAt(double y) const
+{
+    int n = heights.size();
+
+    if(n == 0)
+        return 0;
+
+    int step = 1;
+    while(step * 2 <= n)
+        step *= 2;
+
+    /* walk down taking every node that ends at or above y */
+    int pos = 0;
+
+    for(; step > 0; step /= 2)
+    {
+        if(pos + step <= n && tree[pos + step] <= y)
+        {
+            pos += step;
+            y -= tree[pos];
+        }
+    }
+
+    return std::min(pos, n - 1);
+}
@@ -1,5 +1,10 @@
 #include <assert.h>
+#include <string.h>
 #include <stack>
+#include <stddef.h>
+#include <limits.h>
+#include <map>
+#include <algorithm>
 
 #include <cml/cml.h>
 #include <SFML/Window.hpp>
@@ -7,6 +12,7 @@
 
 #include "gui.h"
 #include "gui_draw.h"
+#include "gui_text.h"
 
 extern sf::RenderWindow window;
 
@@ -25,61 +31,191 @@ static int button_draw_mode;
  *
  * GUI GL drawing functions. Does the actual rendering.
  *
+ * Primitives are expanded into an interleaved vertex array that's drawn
+ * with a single glDrawArrays when the primitive type, texture or clip rect
+ * changes, before text is drawn, and at the end of the frame. Translation is
+ * applied to the vertices on the CPU. Only GL 1.1 client arrays are used so
+ * this runs on software GL.
+ *
  *--------------------------------------------------------------------------*/
+struct GLVertex
+{
+    float x, y;
+    float u, v;
+    unsigned char col[4];
+};
+
+static std::vector<GLVertex> gl_batch;
+static GLenum gl_batch_mode = GL_TRIANGLES;
+static GLuint gl_batch_tex = 0;
+static const sf::Image *gl_batch_image = NULL;
+
+static cml::vector2f gl_translation;
+static std::stack<cml::vector2f> gl_translation_stack;
+
+static GUIRenderStats render_stats, frame_render_stats;
+
+void GUI_GL_Flush()
+{
+    if(gl_batch.empty())
+        return;
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glVertexPointer(2, GL_FLOAT, sizeof(GLVertex), &gl_batch[0].x);
+    glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(GLVertex), gl_batch[0].col);
+
+    bool textured = gl_batch_tex != 0 || gl_batch_image != NULL;
+
+    if(textured)
+    {
+        glEnable(GL_TEXTURE_2D);
+        if(gl_batch_image != NULL)
+            gl_batch_image->Bind();
+        else
+            glBindTexture(GL_TEXTURE_2D, gl_batch_tex);
+        glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+        glTexCoordPointer(2, GL_FLOAT, sizeof(GLVertex), &gl_batch[0].u);
+    }
+
+    glDrawArrays(gl_batch_mode, 0, gl_batch.size());
+
+    if(textured)
+    {
+        glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+        glDisable(GL_TEXTURE_2D);
+    }
+
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+
+    frame_render_stats.draw_calls++;
+    frame_render_stats.vertices += gl_batch.size();
+
+    gl_batch.clear();
+}
+
+/*
+ * starts a new batch if the primitive type or texture changes. SFML images
+ * don't expose their texture id so they're tracked separately.
+ */
+static void batchState(GLenum mode, GLuint tex, const sf::Image *image = NULL)
+{
+    if(mode != gl_batch_mode || tex != gl_batch_tex || image != gl_batch_image)
+    {
+        GUI_GL_Flush();
+        gl_batch_mode = mode;
+        gl_batch_tex = tex;
+        gl_batch_image = image;
+    }
+}
+
+static void batchVertex(float x, float y, float u, float v, const unsigned char *col)
+{
+    GLVertex vert;
+    vert.x = x + gl_translation[0];
+    vert.y = y + gl_translation[1];
+    vert.u = u;
+    vert.v = v;
+    vert.col[0] = col[0]; vert.col[1] = col[1]; vert.col[2] = col[2]; vert.col[3] = col[3];
+    gl_batch.push_back(vert);
+}
+
+static void toBytes(const cml::vector4f &c, unsigned char *out)
+{
+    for(int i = 0; i < 4; i++)
+        out[i] = (unsigned char)(cml::clamp(c[i], 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+static void batchQuad(float x, float y, float w, float h, float u0, float v0, float u1, float v1, const unsigned char *col)
+{
+    batchVertex(x,   y,   u0, v0, col);
+    batchVertex(x+w, y,   u1, v0, col);
+    batchVertex(x+w, y+h, u1, v1, col);
+
+    batchVertex(x,   y,   u0, v0, col);
+    batchVertex(x+w, y+h, u1, v1, col);
+    batchVertex(x,   y+h, u0, v1, col);
+}
+
+void GUI_GL_BeginFrame()
+{
+    gl_translation.zero();
+    gl_translation_stack = std::stack<cml::vector2f>();
+    frame_render_stats.draw_calls = 0;
+    frame_render_stats.vertices = 0;
+}
+
+void GUI_GL_EndFrame()
+{
+    GUI_GL_Flush();
+    render_stats = frame_render_stats;
+}
+
+GUIRenderStats GUI_GetRenderStats()
+{
+    return render_stats;
+}
+
 void GUI_GL_Translate(float x, float y)
 {
-    glTranslatef(x, y, 0.0f);
+    gl_translation[0] += x;
+    gl_translation[1] += y;
 }
 
 void GUI_GL_SetTranslation(float x, float y)
 {
-    glLoadIdentity();
-    glTranslatef(x, y, 0.0f);
+    gl_translation.set(x, y);
 }
 
 void GUI_GL_PushTranslation()
 {
-    glPushMatrix();
+    gl_translation_stack.push(gl_translation);
 }
 
 void GUI_GL_PopTranslation()
 {
-    glPopMatrix();
+    if(gl_translation_stack.empty())
+        return;
+
+    gl_translation = gl_translation_stack.top();
+    gl_translation_stack.pop();
 }
 
 void GUI_GL_SetClipRect(float x, float y, float w, float h)
 {
+    GUI_GL_Flush();
     glScissor(x, y, w, h);
 }
 
 void GUI_GL_Line(float x1, float y1, float x2, float y2, const cml::vector4f &col)
 {
-    glColor4fv(col.data());
-    glBegin(GL_LINES);
-        glVertex2f(x1, y1);
-        glVertex2f(x2, y2);
-    glEnd();
+    unsigned char c[4];
+    toBytes(col, c);
+
+    batchState(GL_LINES, 0);
+    batchVertex(x1, y1, 0.0f, 0.0f, c);
+    batchVertex(x2, y2, 0.0f, 0.0f, c);
 }
 
 void GUI_GL_Triangle(float x0, float y0, float x1, float y1, float x2, float y2, const cml::vector4f &col)
 {
-    glColor4fv(col.data());
-    glBegin(GL_TRIANGLES);
-        glVertex2f(x0, y0);
-        glVertex2f(x1, y1);
-        glVertex2f(x2, y2);
-    glEnd();
+    unsigned char c[4];
+    toBytes(col, c);
+
+    batchState(GL_TRIANGLES, 0);
+    batchVertex(x0, y0, 0.0f, 0.0f, c);
+    batchVertex(x1, y1, 0.0f, 0.0f, c);
+    batchVertex(x2, y2, 0.0f, 0.0f, c);
 }
 
 void GUI_GL_Rect(float x, float y, float w, float h, const cml::vector4f &col)
 {
-    glColor4fv(col.data());
-    glBegin(GL_QUADS);
-        glVertex2f(x, y);
-        glVertex2f(x+w, y);
-        glVertex2f(x+w, y+h);
-        glVertex2f(x, y+h);
-    glEnd();
+    unsigned char c[4];
+    toBytes(col, c);
+
+    batchState(GL_TRIANGLES, 0);
+    batchQuad(x, y, w, h, 0.0f, 0.0f, 0.0f, 0.0f, c);
 }
 
 void GUI_GL_RectOutline(float x, float y, float w, float h, float thickness, const cml::vector4f &col)
@@ -113,32 +249,27 @@ void GUI_GL_RectRaised(float x, float y, float w, float h, float border, const c
 
 void GUI_GL_RectTextured(float x, float y, float w, float h, float tminx, float tminy, float tmaxx, float tmaxy, GLuint tex_id, const cml::vector4f &col)
 {
-    glEnable(GL_TEXTURE_2D);
-    glBindTexture(GL_TEXTURE_2D, tex_id);
-    glColor4fv(col.data());
-    glBegin(GL_QUADS);
-        glTexCoord2f(tminx, tminy);
-        glVertex2f(x, y);
-        glTexCoord2f(tmaxx, tminy);
-        glVertex2f(x+w, y);
-        glTexCoord2f(tmaxx, tmaxy);
-        glVertex2f(x+w, y+h);
-        glTexCoord2f(tminx, tmaxy);
-        glVertex2f(x, y+h);
-    glEnd();
-    glDisable(GL_TEXTURE_2D);
+    unsigned char c[4];
+    toBytes(col, c);
+
+    batchState(GL_TRIANGLES, tex_id);
+    batchQuad(x, y, w, h, tminx, tminy, tmaxx, tmaxy, c);
 }
 
 /*
+ * Text is drawn from the font's own glyph image, which SFML rasterizes once
+ * when the font is loaded, as textured quads in the batch. Other sizes are
+ * the font's glyphs scaled, the same as sf::String does.
+ *
  * x and y in screen space.
  */
-void GUI_GL_TextAligned(float x, float y, float w, float h, int horz, int vert, sf::Font *font, int font_size, const cml::vector4f &font_col, const std::string &str)
+void GUI_GL_TextAligned(float x, float y, float w, float h, int horz, int vert, sf::Font *font, int font_size, const cml::vector4f &font_col, const char *str, size_t len)
 {
-    sf::String txt(str, *font, font_size);
+    const GUIGlyphTable *t = GUI_GlyphTable(font);
+    float scale = font_size / t->char_size;
 
-    sf::FloatRect rect = txt.GetRect();
-    float txt_w = rect.GetWidth();
-    //float txt_h = rect.GetHeight();
+    /* left aligned text doesn't need measuring */
+    float txt_w = horz == GUI_ALIGN_LEFT ? 0.0f : GUI_TextMetrics(font, font_size, str, len).width;
     float txt_h = font_size;
     float txt_x, txt_y;
 
@@ -156,17 +287,42 @@ void GUI_GL_TextAligned(float x, float y, float w, float h, int horz, int vert,
     else
         txt_y = y + h/2.0f - txt_h/2.0f;
 
-    /* floor coordinates or blurry subpixel rendering happens */
-    txt.SetPosition(std::floor(txt_x), std::floor(txt_y));
-    txt.SetColor(sf::Color(font_color[0]*255, font_color[1]*255, font_color[2]*255, font_color[3]*255));
-    window.Draw(txt);
+    /*
+     * floor coordinates or blurry subpixel rendering happens. Text is
+     * already in screen space so undo the translation batchVertex adds.
+     */
+    txt_x = std::floor(txt_x) - gl_translation[0];
+    txt_y = std::floor(txt_y) - gl_translation[1];
+
+    unsigned char col[4];
+    toBytes(font_col, col);
+
+    batchState(GL_TRIANGLES, 0, &font->GetImage());
+
+    /* glyph rects are relative to the baseline, which is one char_size down */
+    float space = t->glyphs[' '].Advance;
+    float pen_x = 0.0f, pen_y = t->char_size;
+
+    size_t i = 0;
+
+    while(i < len)
+    {
+        unsigned int c = GUI_DecodeUTF8(str, len, &i);
+
+        if(c == '\n')       { pen_x = 0.0f; pen_y += t->char_size; continue; }
+        if(c == ' ')        { pen_x += space; continue; }
+        if(c == '\t')       { pen_x += space * 4.0f; continue; }
+
+        const sf::Glyph &g = GUI_Glyph(font, t, c);
+        const sf::IntRect &r = g.Rectangle;
+        const sf::FloatRect &tc = g.TexCoords;
 
-#if 0
-    glPushMatrix();
-    glLoadIdentity();
-    GUI_GL_RectOutline(txt_x, txt_y, txt_w, txt_h, 1, font_col);
-    glPopMatrix();
-#endif
+        batchQuad(txt_x + (pen_x + r.Left) * scale, txt_y + (pen_y + r.Top) * scale,
+                  (r.Right - r.Left) * scale, (r.Bottom - r.Top) * scale,
+                  tc.Left, tc.Top, tc.Right, tc.Bottom, col);
+
+        pen_x += g.Advance;
+    }
 }
 
 
@@ -185,7 +341,10 @@ void GUI_GL_TextAligned(float x, float y, float w, float h, int horz, int vert,
 
 /*--------------------------------------------------------------------------*
  * 
- * Draw command buffering.
+ * Draw command buffering. Commands are packed one after another into a byte
+ * stream. Each is a CmdHeader followed by only the payload its type needs,
+ * padded so the next header stays aligned. Strings are copied into a per
+ * frame arena and referred to by offset.
  *
  *--------------------------------------------------------------------------*/
 enum
@@ -208,90 +367,606 @@ enum
 
 void GUI_BufferPrint();
 
-struct BufferEntry
+#define CMD_ALIGN 8
+
+/* colors are stored as 8 bit RGBA */
+typedef unsigned int CmdColor;
+
+struct CmdHeader
 {
-    int type, layer;
+    unsigned short type;
+    unsigned short size;    /* header and payload, padded to CMD_ALIGN */
+    int layer;
+};
 
-    float         x0,y0,x1,y1,x2,y2,x3,y3;
-    cml::vector4f cols[4];
-    int           ints[4];
-    float         floats[4];
-    GLuint        tex0;
-    void          *data0;
-    std::string   str;
+struct CmdPoint     { float x, y; };
+struct CmdClipRect  { float x, y, w, h; };
+struct CmdLine      { float x0, y0, x1, y1; CmdColor col; };
+struct CmdTriangle  { float x0, y0, x1, y1, x2, y2; CmdColor col; };
+struct CmdRect      { float x, y, w, h; CmdColor col; };
+struct CmdRectOutline { float x, y, w, h, thickness; CmdColor col; };
+struct CmdRectRaised  { float x, y, w, h, border; CmdColor shade1, shade2, fill; };
+struct CmdRectTextured
+{
+    float x, y, w, h;
+    float tminx, tminy, tmaxx, tmaxy;
+    GLuint tex;
+    CmdColor col;
 };
+struct CmdText
+{
+    float x, y, w, h;
+    short horz, vert;
+    int font_size;
+    CmdColor col;
+    unsigned int str;       /* offset into the string arena, nul terminated */
+    unsigned int str_len;
+    unsigned int pad;
+    sf::Font *font;
+};
+
+static std::vector<char> cmd_stream;
+static std::vector<char> string_arena;
+
+/* offsets of the commands in cmd_stream, sorted by layer before executing */
+static std::vector<unsigned int> cmd_order;
+
+/*
+ * Layers used this frame, for the counting sort. A frame that uses a wider
+ * range of layers than LAYER_SORT_MAX_RANGE falls back to a stable sort.
+ */
+#define LAYER_SORT_MAX_RANGE 65536
+static int min_layer = INT_MAX, max_layer = INT_MIN;
+static std::vector<unsigned int> layer_starts;
+static std::vector<unsigned int> cmd_sorted;
 
-static std::vector<BufferEntry> buffer;
 static int draw_layer = 0;
 
+/* hash of the last frame's buffer */
+static GUIHash last_buffer_hash = 0;
+
+
+static CmdColor packColor(const cml::vector4f &c)
+{
+    CmdColor r = (CmdColor)(cml::clamp(c[0], 0.0f, 1.0f) * 255.0f + 0.5f);
+    CmdColor g = (CmdColor)(cml::clamp(c[1], 0.0f, 1.0f) * 255.0f + 0.5f);
+    CmdColor b = (CmdColor)(cml::clamp(c[2], 0.0f, 1.0f) * 255.0f + 0.5f);
+    CmdColor a = (CmdColor)(cml::clamp(c[3], 0.0f, 1.0f) * 255.0f + 0.5f);
+    return r | (g << 8) | (b << 16) | (a << 24);
+}
+
+static cml::vector4f unpackColor(CmdColor c)
+{
+    return cml::vector4f((c & 0xff) / 255.0f, ((c >> 8) & 0xff) / 255.0f,
+                         ((c >> 16) & 0xff) / 255.0f, ((c >> 24) & 0xff) / 255.0f);
+}
+
+/*
+ * Appends a command with a zeroed payload of payload_size bytes and returns
+ * the payload. The pointer is only good until the next command is added.
+ */
+static void *addCommand(int type, size_t payload_size)
+{
+    size_t size = (sizeof(CmdHeader) + payload_size + CMD_ALIGN-1) & ~size_t(CMD_ALIGN-1);
+    size_t offset = cmd_stream.size();
+
+    /* resize zero fills so padding hashes the same every frame */
+    cmd_stream.resize(offset + size);
+
+    CmdHeader *h = (CmdHeader*)&cmd_stream[offset];
+    h->type = type;
+    h->size = size;
+    h->layer = draw_layer;
+
+    cmd_order.push_back(offset);
+    min_layer = std::min(min_layer, draw_layer);
+    max_layer = std::max(max_layer, draw_layer);
+
+    return h + 1;
+}
+
+template<class T> static T *addCommand(int type)
+{
+    return (T*)addCommand(type, sizeof(T));
+}
 
-BufferEntry& addBufferEntry(int type)
+static unsigned int addString(const char *str, size_t len)
 {
-    BufferEntry e;
-    e.type = type;
-    e.layer = draw_layer;
-    buffer.push_back(e);
-    return buffer[buffer.size()-1];
+    unsigned int offset = string_arena.size();
+    string_arena.insert(string_arena.end(), str, str + len);
+    string_arena.push_back('\0');
+    return offset;
 }
 
-static bool bufferSortComp(BufferEntry a, BufferEntry b)
+static const CmdHeader *commandAt(unsigned int offset)
+{
+    return (const CmdHeader*)&cmd_stream[offset];
+}
+
+template<class T> static const T *payload(const CmdHeader *h)
+{
+    return (const T*)(h + 1);
+}
+
+static bool cmdOrderComp(unsigned int a, unsigned int b)
+{
+    return commandAt(a)->layer < commandAt(b)->layer;
+}
+
+/*
+ * Orders cmd_order by layer, keeping call order within a layer. Only the
+ * offsets move.
+ */
+static void sortCommands()
 {
-    return a.layer < b.layer;
+    if(cmd_order.empty() || min_layer == max_layer)
+        return;
+
+    size_t range = size_t(max_layer) - size_t(min_layer) + 1;
+
+    if(range > LAYER_SORT_MAX_RANGE)
+    {
+        std::stable_sort(cmd_order.begin(), cmd_order.end(), cmdOrderComp);
+        return;
+    }
+
+    /* count commands per layer then turn the counts into start offsets */
+    layer_starts.assign(range + 1, 0);
+
+    for(size_t i = 0; i < cmd_order.size(); i++)
+        layer_starts[commandAt(cmd_order[i])->layer - min_layer + 1]++;
+
+    for(size_t l = 0; l < range; l++)
+        layer_starts[l+1] += layer_starts[l];
+
+    cmd_sorted.resize(cmd_order.size());
+
+    for(size_t i = 0; i < cmd_order.size(); i++)
+        cmd_sorted[layer_starts[commandAt(cmd_order[i])->layer - min_layer]++] = cmd_order[i];
+
+    cmd_order.swap(cmd_sorted);
 }
 
 void GUI_BufferExecute()
 {
     //std::cout << "before---------------------------------------------------------\n";
     //GUI_BufferPrint();
-    std::stable_sort(buffer.begin(), buffer.end(), bufferSortComp);
+    sortCommands();
     //std::cout << "after----------------------------------------------------------\n";
     //GUI_BufferPrint();
 
-    for(size_t i = 0; i < buffer.size(); i++)
+    for(size_t i = 0; i < cmd_order.size(); i++)
     {
-        BufferEntry &e = buffer[i];
+        const CmdHeader *h = commandAt(cmd_order[i]);
 
-        switch(e.type)
+        switch(h->type)
         {
-            case CMD_TRANSLATE:         GUI_GL_Translate(e.x0, e.y0); break;
-            case CMD_TRANSLATE_SET:     GUI_GL_SetTranslation(e.x0, e.y0); break;
+            case CMD_TRANSLATE:
+            {
+                const CmdPoint *c = payload<CmdPoint>(h);
+                GUI_GL_Translate(c->x, c->y);
+                break;
+            }
+            case CMD_TRANSLATE_SET:
+            {
+                const CmdPoint *c = payload<CmdPoint>(h);
+                GUI_GL_SetTranslation(c->x, c->y);
+                break;
+            }
             case CMD_TRANSLATE_PUSH:    GUI_GL_PushTranslation(); break;
             case CMD_TRANSLATE_POP:     GUI_GL_PopTranslation(); break;
-            case CMD_CLIP_RECT_SET:     GUI_GL_SetClipRect(e.x0, e.y0, e.x1, e.y1); break;
-
-            case CMD_LINE:              GUI_GL_Line(e.x0, e.y0, e.x1, e.y1, e.cols[0]); break;
-            case CMD_TRIANGLE:          GUI_GL_Triangle(e.x0, e.y0, e.x1, e.y1, e.x2, e.y2, e.cols[0]); break;
-            case CMD_RECT:              GUI_GL_Rect(e.x0, e.y0, e.x1, e.y1, e.cols[0]); break;
-            case CMD_RECT_OUTLINE:      GUI_GL_RectOutline(e.x0, e.y0, e.x1, e.y1, e.floats[0], e.cols[0]); break;
-            case CMD_RECT_RAISED:       GUI_GL_RectRaised(e.x0, e.y0, e.x1, e.y1, e.floats[0], e.cols[0], e.cols[1], e.cols[2]); break;
-            case CMD_RECT_TEXTURED:     GUI_GL_RectTextured(e.x0, e.y0, e.x1, e.y1, e.x2, e.y2, e.x3, e.y3, e.tex0, e.cols[0]); break;
-            case CMD_TEXT:              GUI_GL_TextAligned(e.x0, e.y0, e.x1, e.y1, e.ints[0], e.ints[1], (sf::Font*)e.data0, e.ints[2], e.cols[0], e.str); break;
+            case CMD_CLIP_RECT_SET:
+            {
+                const CmdClipRect *c = payload<CmdClipRect>(h);
+                GUI_GL_SetClipRect(c->x, c->y, c->w, c->h);
+                break;
+            }
+
+            case CMD_LINE:
+            {
+                const CmdLine *c = payload<CmdLine>(h);
+                GUI_GL_Line(c->x0, c->y0, c->x1, c->y1, unpackColor(c->col));
+                break;
+            }
+            case CMD_TRIANGLE:
+            {
+                const CmdTriangle *c = payload<CmdTriangle>(h);
+                GUI_GL_Triangle(c->x0, c->y0, c->x1, c->y1, c->x2, c->y2, unpackColor(c->col));
+                break;
+            }
+            case CMD_RECT:
+            {
+                const CmdRect *c = payload<CmdRect>(h);
+                GUI_GL_Rect(c->x, c->y, c->w, c->h, unpackColor(c->col));
+                break;
+            }
+            case CMD_RECT_OUTLINE:
+            {
+                const CmdRectOutline *c = payload<CmdRectOutline>(h);
+                GUI_GL_RectOutline(c->x, c->y, c->w, c->h, c->thickness, unpackColor(c->col));
+                break;
+            }
+            case CMD_RECT_RAISED:
+            {
+                const CmdRectRaised *c = payload<CmdRectRaised>(h);
+                GUI_GL_RectRaised(c->x, c->y, c->w, c->h, c->border, unpackColor(c->shade1), unpackColor(c->shade2), unpackColor(c->fill));
+                break;
+            }
+            case CMD_RECT_TEXTURED:
+            {
+                const CmdRectTextured *c = payload<CmdRectTextured>(h);
+                GUI_GL_RectTextured(c->x, c->y, c->w, c->h, c->tminx, c->tminy, c->tmaxx, c->tmaxy, c->tex, unpackColor(c->col));
+                break;
+            }
+            case CMD_TEXT:
+            {
+                const CmdText *c = payload<CmdText>(h);
+                GUI_GL_TextAligned(c->x, c->y, c->w, c->h, c->horz, c->vert, c->font, c->font_size, unpackColor(c->col), &string_arena[c->str], c->str_len);
+                break;
+            }
             //case CMD_FRAME:             GUI_GL_Frame(e.x0, e.y0, e.x1, e.y1); break;
             default: break;
         }
     }
 }
 
+/*
+ * Hashes everything that affects what the buffer draws. Two frames with the
+ * same hash produce the same image.
+ */
+static GUIHash bufferHash()
+{
+    GUIHash h = GUI_HASH_OFFSET;
+
+    if(!cmd_stream.empty())
+        h = GUI_HashBytes(&cmd_stream[0], cmd_stream.size(), h);
+    if(!string_arena.empty())
+        h = GUI_HashBytes(&string_arena[0], string_arena.size(), h);
+
+    return h;
+}
+
+
+
+/*--------------------------------------------------------------------------*
+ *
+ * Damage tracking. The sorted buffer is split into groups of commands that
+ * share a layer and clip rect. Each group gets a hash of the translation it
+ * starts with and its commands, and the screen space bounds of what it
+ * draws. Groups are matched against last frame's by (layer, clip rect, n-th
+ * group with that layer and clip rect) and any group that changed, appeared
+ * or disappeared dirties its old and new bounds.
+ *
+ *--------------------------------------------------------------------------*/
+#define DAMAGE_MAX_RECTS 16
+#define DAMAGE_MERGE_LIMIT 64
+
+struct DamageGroup
+{
+    GUIHash key;
+    GUIHash hash;
+    GUI_AABB bounds;
+    bool empty;
+};
+
+static std::vector<DamageGroup> damage_groups, last_damage_groups;
+static std::map<GUIHash, int> damage_key_counts;
+static std::vector<GUI_AABB> damage_rects;
+static GUIDamageStats damage_stats;
+
+static void addBounds(DamageGroup &g, float x0, float y0, float x1, float y1)
+{
+    GUI_AABB r(x0, y0, x1, y1);
+
+    if(g.empty)
+        g.bounds = r;
+    else
+        g.bounds = GUI_AABB(std::min(g.bounds.min[0], r.min[0]), std::min(g.bounds.min[1], r.min[1]),
+                            std::max(g.bounds.max[0], r.max[0]), std::max(g.bounds.max[1], r.max[1]));
+    g.empty = false;
+}
+
+/*
+ * Text is only measured when it's drawn, so its bounds are a guess that's
+ * at least as big as the string: no glyph is wider than the font size.
+ */
+static void addTextBounds(DamageGroup &g, const CmdText *c)
+{
+    float size = c->font_size;
+    float tw = size * c->str_len;
+    float th = size * 1.5f;
+    float tx = c->x, ty = c->y;
+
+    if(c->horz == GUI_ALIGN_RIGHT)         tx = c->x + c->w - tw;
+    else if(c->horz != GUI_ALIGN_LEFT)     tx = c->x + c->w/2.0f - tw/2.0f;
+
+    if(c->vert == GUI_ALIGN_BOTTOM)        ty = c->y + c->h - th;
+    else if(c->vert != GUI_ALIGN_TOP)      ty = c->y + c->h/2.0f - th/2.0f;
+
+    addBounds(g, tx, ty, tx + tw, ty + th);
+}
+
+template<class T> static GUIHash hashValue(GUIHash h, const T &v)
+{
+    return GUI_HashBytes((const char*)&v, sizeof(T), h);
+}
+
+/*
+ * Text is hashed by content rather than by its arena offset, which changes
+ * whenever any earlier string does. The font generation goes in too, since a
+ * reloaded font can keep its address.
+ */
+static GUIHash commandHash(const CmdHeader *h, GUIHash hash)
+{
+    if(h->type != CMD_TEXT)
+        return GUI_HashBytes((const char*)h, h->size, hash);
+
+    const CmdText *c = payload<CmdText>(h);
+    hash = GUI_HashBytes((const char*)h, sizeof(CmdHeader) + offsetof(CmdText, str), hash);
+    hash = GUI_HashBytes(&string_arena[c->str], c->str_len, hash);
+    hash = hashValue(hash, c->font);
+    return hashValue(hash, GUI_FontGeneration());
+}
+
+static bool damageGroupComp(const DamageGroup &a, const DamageGroup &b)
+{
+    return a.key < b.key;
+}
+
+static float area(const GUI_AABB &r)
+{
+    return r.isEmpty() ? 0.0f : r.getWidth() * r.getHeight();
+}
+
+static GUI_AABB unionOf(const GUI_AABB &a, const GUI_AABB &b)
+{
+    return GUI_AABB(std::min(a.min[0], b.min[0]), std::min(a.min[1], b.min[1]),
+                    std::max(a.max[0], b.max[0]), std::max(a.max[1], b.max[1]));
+}
+
+static void addDamage(const DamageGroup &g)
+{
+    if(!g.empty && !g.bounds.isEmpty())
+        damage_rects.push_back(g.bounds);
+}
+
+static void collapseDamage()
+{
+    for(size_t i = 1; i < damage_rects.size(); i++)
+        damage_rects[0] = unionOf(damage_rects[0], damage_rects[i]);
+    damage_rects.resize(1);
+}
+
+/*
+ * Merges rects whose union costs no more than drawing both. If there are
+ * still too many left they're collapsed into one. More than
+ * DAMAGE_MERGE_LIMIT rects would make the pairwise merge cost more than the
+ * redraw it saves, so they're collapsed straight away.
+ */
+static void mergeDamage()
+{
+    if(damage_rects.size() > DAMAGE_MERGE_LIMIT)
+    {
+        collapseDamage();
+        return;
+    }
+
+    for(size_t i = 0; i < damage_rects.size(); i++)
+    {
+        /* rect i grows as others merge into it, so rescan after each merge */
+        size_t j = i+1;
+
+        while(j < damage_rects.size())
+        {
+            GUI_AABB u = unionOf(damage_rects[i], damage_rects[j]);
+
+            if(area(u) <= area(damage_rects[i]) + area(damage_rects[j]))
+            {
+                damage_rects[i] = u;
+                damage_rects.erase(damage_rects.begin() + j);
+                j = i+1;
+            }
+            else
+            {
+                j++;
+            }
+        }
+    }
+
+    if(damage_rects.size() > DAMAGE_MAX_RECTS)
+        collapseDamage();
+}
+
+/*
+ * Must be called after cmd_order has been sorted.
+ */
+static void computeDamage()
+{
+    float screen_w = window.GetWidth();
+    float screen_h = window.GetHeight();
+    GUI_AABB screen(0.0f, 0.0f, screen_w, screen_h);
+
+    cml::vector2f t(0.0f, 0.0f);
+    std::stack<cml::vector2f> t_stack;
+    GUI_AABB clip = screen;
+    int layer = 0;
+
+    damage_groups.clear();
+    damage_key_counts.clear();
+    damage_rects.clear();
+
+    DamageGroup *g = NULL;
+
+    for(size_t i = 0; i < cmd_order.size(); i++)
+    {
+        const CmdHeader *h = commandAt(cmd_order[i]);
+
+        if(h->type == CMD_CLIP_RECT_SET)
+        {
+            /* scissor rects are stored bottom up */
+            const CmdClipRect *c = payload<CmdClipRect>(h);
+            GUI_AABB r = GUI_AABB::fromPositionSize(c->x, screen_h - c->y - c->h, c->w, c->h);
+
+            if(g != NULL && h->layer == layer && r.min == clip.min && r.max == clip.max)
+                continue;
+
+            clip = r;
+            g = NULL;
+        }
+
+        if(g == NULL || h->layer != layer)
+        {
+            layer = h->layer;
+
+            GUIHash clip_key = hashValue(GUI_HASH_OFFSET, layer);
+            clip_key = GUI_HashBytes((const char*)clip.min.data(), 2*sizeof(float), clip_key);
+            clip_key = GUI_HashBytes((const char*)clip.max.data(), 2*sizeof(float), clip_key);
+
+            /*
+             * the translation carried in from earlier groups moves everything
+             * this group draws, so it's part of what the group looks like
+             */
+            DamageGroup ng;
+            ng.key = hashValue(clip_key, damage_key_counts[clip_key]++);
+            ng.hash = GUI_HashBytes((const char*)t.data(), 2*sizeof(float), GUI_HASH_OFFSET);
+            ng.empty = true;
+            damage_groups.push_back(ng);
+            g = &damage_groups.back();
+        }
+
+        g->hash = commandHash(h, g->hash);
+
+        switch(h->type)
+        {
+            case CMD_TRANSLATE:
+            {
+                const CmdPoint *c = payload<CmdPoint>(h);
+                t += cml::vector2f(c->x, c->y);
+                break;
+            }
+            case CMD_TRANSLATE_SET:
+            {
+                const CmdPoint *c = payload<CmdPoint>(h);
+                t.set(c->x, c->y);
+                break;
+            }
+            case CMD_TRANSLATE_PUSH:    t_stack.push(t); break;
+            case CMD_TRANSLATE_POP:     if(!t_stack.empty()) { t = t_stack.top(); t_stack.pop(); } break;
+
+            case CMD_LINE:
+            {
+                const CmdLine *c = payload<CmdLine>(h);
+                addBounds(*g, t[0] + std::min(c->x0, c->x1) - 1.0f, t[1] + std::min(c->y0, c->y1) - 1.0f,
+                              t[0] + std::max(c->x0, c->x1) + 1.0f, t[1] + std::max(c->y0, c->y1) + 1.0f);
+                break;
+            }
+            case CMD_TRIANGLE:
+            {
+                const CmdTriangle *c = payload<CmdTriangle>(h);
+                addBounds(*g, t[0] + std::min(std::min(c->x0, c->x1), c->x2), t[1] + std::min(std::min(c->y0, c->y1), c->y2),
+                              t[0] + std::max(std::max(c->x0, c->x1), c->x2), t[1] + std::max(std::max(c->y0, c->y1), c->y2));
+                break;
+            }
+            /* all rect payloads start with x, y, w, h */
+            case CMD_RECT:
+            case CMD_RECT_OUTLINE:
+            case CMD_RECT_RAISED:
+            case CMD_RECT_TEXTURED:
+            {
+                const CmdClipRect *c = payload<CmdClipRect>(h);
+                addBounds(*g, t[0] + c->x, t[1] + c->y, t[0] + c->x + c->w, t[1] + c->y + c->h);
+                break;
+            }
+            case CMD_TEXT:
+                addTextBounds(*g, payload<CmdText>(h));
+                break;
+            default: break;
+        }
+
+        /* nothing is drawn outside the clip rect */
+        if(!g->empty)
+            g->bounds = clip.intersection(g->bounds);
+    }
+
+    std::sort(damage_groups.begin(), damage_groups.end(), damageGroupComp);
+
+    /* walk both sorted lists, dirtying anything that isn't in both unchanged */
+    size_t a = 0, b = 0;
+
+    while(a < last_damage_groups.size() || b < damage_groups.size())
+    {
+        if(b == damage_groups.size() || (a < last_damage_groups.size() && last_damage_groups[a].key < damage_groups[b].key))
+        {
+            addDamage(last_damage_groups[a++]);
+        }
+        else if(a == last_damage_groups.size() || damage_groups[b].key < last_damage_groups[a].key)
+        {
+            addDamage(damage_groups[b++]);
+        }
+        else
+        {
+            if(last_damage_groups[a].hash != damage_groups[b].hash)
+            {
+                addDamage(last_damage_groups[a]);
+                addDamage(damage_groups[b]);
+            }
+            a++; b++;
+        }
+    }
+
+    mergeDamage();
+
+    last_damage_groups.swap(damage_groups);
+
+    float dirty = 0.0f;
+    for(size_t i = 0; i < damage_rects.size(); i++)
+    {
+        damage_rects[i] = screen.intersection(damage_rects[i]);
+        dirty += area(damage_rects[i]);
+    }
+
+    float percent = area(screen) > 0.0f ? std::min(100.0f, 100.0f * dirty / area(screen)) : 0.0f;
+
+    damage_stats.frames++;
+    damage_stats.rects = damage_rects.size();
+    damage_stats.dirty_percent = percent;
+    damage_stats.average_percent += (percent - damage_stats.average_percent) / damage_stats.frames;
+}
+
+const std::vector<GUI_AABB>& GUI_GetDamageRects()
+{
+    return damage_rects;
+}
+
+GUIDamageStats GUI_GetDamageStats()
+{
+    return damage_stats;
+}
+
 void GUI_BufferClear()
 {
-    buffer.clear();
+    cmd_stream.clear();
+    cmd_order.clear();
+    min_layer = INT_MAX;
+    max_layer = INT_MIN;
+    string_arena.clear();
 }
 
 void GUI_BufferPrint()
 {
-    for(size_t i = 0; i < buffer.size(); i++)
+    for(size_t i = 0; i < cmd_order.size(); i++)
     {
-        BufferEntry &e = buffer[i];
+        const CmdHeader *h = commandAt(cmd_order[i]);
 
-        std::cout << e.layer << ": ";
+        std::cout << h->layer << ": ";
 
-        switch(e.type)
+        switch(h->type)
         {
             case CMD_TRANSLATE:         
-                std::cout << "TRANSLATE(" << e.x0 << ", " << e.y0 << ")\n";
+                std::cout << "TRANSLATE(" << payload<CmdPoint>(h)->x << ", " << payload<CmdPoint>(h)->y << ")\n";
                 break;
             case CMD_TRANSLATE_SET:         
-                std::cout << "TRANSLATE_SET(" << e.x0 << ", " << e.y0 << ")\n";
+                std::cout << "TRANSLATE_SET(" << payload<CmdPoint>(h)->x << ", " << payload<CmdPoint>(h)->y << ")\n";
                 break;
             case CMD_TRANSLATE_PUSH:    
                 std::cout << "TRANSLATE_PUSH\n";
@@ -322,8 +997,11 @@ void GUI_BufferPrint()
                 std::cout << "RECT_TEXTURED\n";
                 break;
             case CMD_TEXT:              
-                std::cout << "TEXT(" << e.x0 << ", " << e.y0 << ", " << e.x1 << ", " << e.y1 << ", " << e.ints[0] << ", " << e.ints[1] << ", " << e.str << ")\n";
+            {
+                const CmdText *c = payload<CmdText>(h);
+                std::cout << "TEXT(" << c->x << ", " << c->y << ", " << c->w << ", " << c->h << ", " << c->horz << ", " << c->vert << ", " << &string_arena[c->str] << ")\n";
                 break;
+            }
             default: break;
         }
     }
@@ -337,52 +1015,52 @@ void GUI_BufferPrint()
 
 void GUI_DrawLine(float x0, float y0, float x1, float y1, const cml::vector4f &col)
 {
-    BufferEntry &e = addBufferEntry(CMD_LINE);
-    e.x0 = x0; e.y0 = y0;
-    e.x1 = x1; e.y1 = y1;
-    e.cols[0] = col;
+    CmdLine *c = addCommand<CmdLine>(CMD_LINE);
+    c->x0 = x0; c->y0 = y0;
+    c->x1 = x1; c->y1 = y1;
+    c->col = packColor(col);
 }
 
 void GUI_DrawTriangle(float x0, float y0, float x1, float y1, float x2, float y2, const cml::vector4f &col)
 {
-    BufferEntry &e = addBufferEntry(CMD_TRIANGLE);
-    e.x0 = x0; e.y0 = y0;
-    e.x1 = x1; e.y1 = y1;
-    e.x2 = x2; e.y2 = y2;
-    e.cols[0] = col;
+    CmdTriangle *c = addCommand<CmdTriangle>(CMD_TRIANGLE);
+    c->x0 = x0; c->y0 = y0;
+    c->x1 = x1; c->y1 = y1;
+    c->x2 = x2; c->y2 = y2;
+    c->col = packColor(col);
 }
 
 void GUI_DrawRect(float x, float y, float w, float h, const cml::vector4f &col)
 {
-    BufferEntry &e = addBufferEntry(CMD_RECT);
-    e.x0 = x; e.y0 = y; e.x1 = w; e.y1 = h;
-    e.cols[0] = col;
+    CmdRect *c = addCommand<CmdRect>(CMD_RECT);
+    c->x = x; c->y = y; c->w = w; c->h = h;
+    c->col = packColor(col);
 }
 
 void GUI_DrawRectOutline(float x, float y, float w, float h, float thickness, const cml::vector4f &col)
 {
-    BufferEntry &e = addBufferEntry(CMD_RECT_OUTLINE);
-    e.x0 = x; e.y0 = y; e.x1 = w; e.y1 = h;
-    e.cols[0] = col;
-    e.floats[0] = thickness;
+    CmdRectOutline *c = addCommand<CmdRectOutline>(CMD_RECT_OUTLINE);
+    c->x = x; c->y = y; c->w = w; c->h = h;
+    c->thickness = thickness;
+    c->col = packColor(col);
 }
 
 void GUI_DrawRectRaised(float x, float y, float w, float h, float border, const cml::vector4f &shade1, const cml::vector4f &shade2, const cml::vector4f &fill_col)
 {
-    BufferEntry &e = addBufferEntry(CMD_RECT_RAISED);
-    e.x0 = x; e.y0 = y; e.x1 = w; e.y1 = h;
-    e.cols[0] = shade1; e.cols[1] = shade2; e.cols[2] = fill_col;
-    e.floats[0] = border;
+    CmdRectRaised *c = addCommand<CmdRectRaised>(CMD_RECT_RAISED);
+    c->x = x; c->y = y; c->w = w; c->h = h;
+    c->border = border;
+    c->shade1 = packColor(shade1); c->shade2 = packColor(shade2); c->fill = packColor(fill_col);
 }
 
 void GUI_DrawRectTextured(float x, float y, float w, float h, float tminx, float tminy, float tmaxx, float tmaxy, GLuint tex_id, const cml::vector4f &col)
 {
-    BufferEntry &e = addBufferEntry(CMD_RECT_TEXTURED);
-    e.x0 = x; e.y0 = y; e.x1 = w; e.y1 = h;
-    e.x2 = tminx; e.y2 = tminy;
-    e.x3 = tmaxx; e.y3 = tmaxy;
-    e.cols[0] = col;
-    e.tex0 = tex_id;
+    CmdRectTextured *c = addCommand<CmdRectTextured>(CMD_RECT_TEXTURED);
+    c->x = x; c->y = y; c->w = w; c->h = h;
+    c->tminx = tminx; c->tminy = tminy;
+    c->tmaxx = tmaxx; c->tmaxy = tmaxy;
+    c->tex = tex_id;
+    c->col = packColor(col);
 }
 
 void GUI_DrawText(float x, float y, const std::string &str)
@@ -391,19 +1069,29 @@ void GUI_DrawText(float x, float y, const std::string &str)
 }
 
 void GUI_DrawTextAligned(float x, float y, float w, float h, int horz, int vert, const std::string &str)
+{
+    GUI_DrawTextAligned(x, y, w, h, horz, vert, str.data(), str.size());
+}
+
+void GUI_DrawTextAligned(float x, float y, float w, float h, int horz, int vert, const char *str, size_t len)
 {
     if(font_ptr == NULL)
         return;
 
-    BufferEntry &e = addBufferEntry(CMD_TEXT);
-    e.x0 = translation[0] + x; e.y0 = translation[1] + y;
-    e.x1 = w; e.y1 = h;
-    e.ints[0] = horz; e.ints[1] = vert; e.ints[2] = font_size;
-    e.cols[0] = font_color;
-    e.str = str;
-    e.data0 = font_ptr;
+    unsigned int str_offset = addString(str, len);
+
+    CmdText *c = addCommand<CmdText>(CMD_TEXT);
+    c->x = translation[0] + x; c->y = translation[1] + y;
+    c->w = w; c->h = h;
+    c->horz = horz; c->vert = vert;
+    c->font_size = font_size;
+    c->col = packColor(font_color);
+    c->str = str_offset;
+    c->str_len = len;
+    c->font = font_ptr;
 }
 
+
 void GUI_DrawArrow(float x, float y, float w, float h, int dir, const cml::vector4f &col)
 {
     float cx = x + w/2.0f;
@@ -459,20 +1147,34 @@ void GUI_DrawBegin()
     glEnable(GL_BLEND);
     glDisable(GL_CULL_FACE);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    GUI_GL_BeginFrame();
 }
 
-void GUI_DrawEnd()
+/*
+ * Executes the buffered commands. Returns true if they differ from the last
+ * frame's commands.
+ */
+bool GUI_DrawEnd()
 {
+    GUIHash h = bufferHash();
+    bool changed = h != last_buffer_hash;
+    last_buffer_hash = h;
+
     GUI_BufferExecute();
+    GUI_GL_EndFrame();
+    computeDamage();
     GUI_BufferClear();
 
     glPopAttrib();
+
+    return changed;
 }
 
 void GUI_DrawTranslate(float x, float y)
 {
-    BufferEntry &e = addBufferEntry(CMD_TRANSLATE);
-    e.x0 = x; e.y0 = y;
+    CmdPoint *c = addCommand<CmdPoint>(CMD_TRANSLATE);
+    c->x = x; c->y = y;
 
     translation[0] += x;
     translation[1] += y;
@@ -480,15 +1182,15 @@ void GUI_DrawTranslate(float x, float y)
 
 void GUI_DrawSetTranslation(float x, float y)
 {
-    BufferEntry &e = addBufferEntry(CMD_TRANSLATE_SET);
-    e.x0 = x; e.y0 = y;
+    CmdPoint *c = addCommand<CmdPoint>(CMD_TRANSLATE_SET);
+    c->x = x; c->y = y;
 
     translation[0] = x;
     translation[1] = y;
 }
 void GUI_DrawPushTranslation()
 {
-    BufferEntry &e = addBufferEntry(CMD_TRANSLATE_PUSH);
+    addCommand(CMD_TRANSLATE_PUSH, 0);
     translation_stack.push(translation);
 }
 
@@ -496,15 +1198,15 @@ void GUI_DrawPopTranslation()
 {
     assert(!translation_stack.empty());
 
-    BufferEntry &e = addBufferEntry(CMD_TRANSLATE_POP);
+    addCommand(CMD_TRANSLATE_POP, 0);
     translation = translation_stack.top();
     translation_stack.pop();
 }
 
 void GUI_DrawSetClipRect(float x, float y, float w, float h)
 {
-    BufferEntry &e = addBufferEntry(CMD_CLIP_RECT_SET);
-    e.x0 = x; e.y0 = y; e.x1 = w; e.y1 = h;
+    CmdClipRect *c = addCommand<CmdClipRect>(CMD_CLIP_RECT_SET);
+    c->x = x; c->y = y; c->w = w; c->h = h;
 
     clip_x = x; clip_y = y; clip_w = w; clip_h = h;
 }
@@ -619,7 +1321,10 @@ void GUI_DrawCheckboxLabelled(float x, float y, float w, float h, float cx, floa
     GUI_DrawText(x + cw + 3, y, str);
 }
 
-void GUI_DrawEditBox(float x, float y, float w, float h, bool active, int caret_pos, int selection, float str_offset, const std::string &str)
+/*
+ * pos holds the x position of each character in str, as kept by the edit box.
+ */
+void GUI_DrawEditBox(float x, float y, float w, float h, bool active, int caret_pos, int selection, float str_offset, const std::string &str, const std::vector<float> *pos)
 {
     cml::vector4f bg_active_col  (131.0f/255.0f, 129.0f/255.0f, 131.0f/255.0f, 1.0f);
     cml::vector4f bg_inactive_col(111.0f/255.0f, 109.0f/255.0f, 111.0f/255.0f, 1.0f);
@@ -631,31 +1336,141 @@ void GUI_DrawEditBox(float x, float y, float w, float h, bool active, int caret_
     GUI_DrawRect(x, y, w, h, active ? bg_active_col : bg_inactive_col);
 
     /* font stuff */
-    if(font_ptr)
+    if(font_ptr && pos != NULL)
     {
-        sf::String txt(str, *font_ptr, font_size);
-        sf::Vector2f caret_vec = txt.GetCharacterPos(caret_pos);
+        float caret_x = (*pos)[caret_pos];
 
         /* highlight selected text before drawing the string */
         if(selection != 0)
         {
-            sf::Vector2f selection_vec = txt.GetCharacterPos(caret_pos + selection);
-            float minx = std::min(caret_vec.x, selection_vec.x);
-            float maxx = std::max(caret_vec.x, selection_vec.x);
+            float selection_x = (*pos)[caret_pos + selection];
+            float minx = std::min(caret_x, selection_x);
+            float maxx = std::max(caret_x, selection_x);
             GUI_DrawRect(x+minx+str_offset, y, maxx-minx, h, highlight_col);
         }
 
-        GUI_DrawTextAligned(x+str_offset, y, txt.GetRect().GetWidth(), h, GUI_ALIGN_LEFT, GUI_ALIGN_CENTER, str.c_str());
+        GUI_DrawTextAligned(x+str_offset, y, pos->back(), h, GUI_ALIGN_LEFT, GUI_ALIGN_CENTER, str.c_str());
 
         /* draw the caret above everything */
-        if(active) GUI_DrawRect(x+caret_vec.x+str_offset, y, 1, h, caret_col);
+        if(active) GUI_DrawRect(x+caret_x+str_offset, y, 1, h, caret_col);
     }
 
     /* outline */
     GUI_DrawRectOutline(x, y, w, h, 1.0f, border_col);
 }
 
-void GUI_DrawListbox(float x, float y, float w, float h, float item_height, const std::vector<std::string> &data, int data_offset, int choice)
+/*
+ * Draws the lines of text that fit from first_line down. offset is the x
+ * position lines start at. Only the lines with the caret or part of the
+ * selection on them are measured.
+ */
+void GUI_DrawTextEditor(float x, float y, float w, float h, bool active, float line_h, float offset, const GUITextBuffer &text, size_t first_line, size_t caret, size_t anchor)
+{
+    cml::vector4f bg_active_col  (131.0f/255.0f, 129.0f/255.0f, 131.0f/255.0f, 1.0f);
+    cml::vector4f bg_inactive_col(111.0f/255.0f, 109.0f/255.0f, 111.0f/255.0f, 1.0f);
+    cml::vector4f highlight_col  ( 49.0f/255.0f,  97.0f/255.0f, 131.0f/255.0f, 1.0f);
+    cml::vector4f caret_col      (  0.0f/255.0f,   0.0f/255.0f,   0.0f/255.0f, 1.0f);
+    cml::vector4f border_col     ( 64.0f/255.0f,  64.0f/255.0f,  64.0f/255.0f, 1.0f);
+
+    GUI_DrawRect(x, y, w, h, active ? bg_active_col : bg_inactive_col);
+
+    if(font_ptr)
+    {
+        static std::string line_str;
+
+        size_t sel_lo = std::min(caret, anchor);
+        size_t sel_hi = std::max(caret, anchor);
+        size_t last = std::min(text.lineCount(), first_line + (size_t)(h / line_h) + 1);
+        float line_y = y;
+
+        for(size_t line = first_line; line < last; line++, line_y += line_h)
+        {
+            size_t start = text.lineStart(line);
+            size_t end = text.lineEnd(line);
+            text.copy(start, end - start, &line_str);
+
+            bool has_caret = active && start <= caret && caret <= end;
+            bool has_selection = sel_lo < sel_hi && sel_lo <= end && start < sel_hi;
+            float caret_x = 0.0f;
+
+            if(has_caret || has_selection)
+            {
+                const std::vector<float> &pos = GUI_TextMetrics(font_ptr, font_size, line_str.data(), line_str.size()).pos;
+
+                if(has_selection)
+                {
+                    float x0 = pos[std::max(sel_lo, start) - start];
+                    /* a selected newline shows as a little extra highlight */
+                    float x1 = sel_hi > end ? pos.back() + 4.0f : pos[sel_hi - start];
+                    GUI_DrawRect(x+offset+x0, line_y, x1-x0, line_h, highlight_col);
+                }
+
+                if(has_caret)
+                    caret_x = pos[caret - start];
+            }
+
+            GUI_DrawTextAligned(x+offset, line_y, 0.0f, line_h, GUI_ALIGN_LEFT, GUI_ALIGN_CENTER, line_str);
+
+            if(has_caret)
+                GUI_DrawRect(x+offset+caret_x, line_y, 1, line_h, caret_col);
+        }
+    }
+
+    GUI_DrawRectOutline(x, y, w, h, 1.0f, border_col);
+}
+
+void GUI_DrawLogConsole(float x, float y, float w, float h, float line_h, const GUILog &log, size_t first_row)
+{
+    cml::vector4f bg_col    (111.0f/255.0f, 109.0f/255.0f, 111.0f/255.0f, 1.0f);
+    cml::vector4f border_col( 64.0f/255.0f,  64.0f/255.0f,  64.0f/255.0f, 1.0f);
+
+    float line_y = y;
+
+    GUI_DrawRect(x, y, w, h, bg_col);
+
+    for(size_t row = first_row; row < log.lineCount() && line_y < y+h; row++, line_y += line_h)
+    {
+        size_t len;
+        const char *s = log.line(row, &len);
+        GUI_DrawTextAligned(x+2.0f, line_y, 0.0f, line_h, GUI_ALIGN_LEFT, GUI_ALIGN_CENTER, s, len);
+    }
+
+    GUI_DrawRectOutline(x, y, w, h, 1.0f, border_col);
+}
+
+/*
+ * Lines are drawn straight from the mapping. Only the start of a very long
+ * line is drawn since there's no horizontal scrolling. progress below 1 shows
+ * as a bar along the bottom while the file is being indexed.
+ */
+void GUI_DrawFileViewer(float x, float y, float w, float h, float line_h, GUIMappedFile &file, size_t first_row, size_t rows, float progress)
+{
+    cml::vector4f bg_col      (111.0f/255.0f, 109.0f/255.0f, 111.0f/255.0f, 1.0f);
+    cml::vector4f progress_col( 49.0f/255.0f,  97.0f/255.0f, 131.0f/255.0f, 1.0f);
+    cml::vector4f border_col  ( 64.0f/255.0f,  64.0f/255.0f,  64.0f/255.0f, 1.0f);
+
+    size_t max_len = 1024;
+    float line_y = y;
+
+    GUI_DrawRect(x, y, w, h, bg_col);
+
+    for(size_t row = first_row; row < rows && line_y < y+h; row++, line_y += line_h)
+    {
+        size_t len;
+        const char *s = file.line(row, &len);
+        GUI_DrawTextAligned(x+2.0f, line_y, 0.0f, line_h, GUI_ALIGN_LEFT, GUI_ALIGN_CENTER, s, std::min(len, max_len));
+    }
+
+    if(progress < 1.0f)
+        GUI_DrawRect(x, y+h-4.0f, w*progress, 4.0f, progress_col);
+
+    GUI_DrawRectOutline(x, y, w, h, 1.0f, border_col);
+}
+
+/*
+ * text supplies the rows, and is only asked for the ones in view.
+ */
+void GUI_DrawListbox(float x, float y, float w, float h, float item_height, int count, const char *(*text)(int row, void *user), void *user, int data_offset, int choice)
 {
     cml::vector4f bg_1(131.0f/255.0f, 129.0f/255.0f, 131.0f/255.0f, 1.0f);
     cml::vector4f bg_2(162.0f/255.0f, 165.0f/255.0f, 162.0f/255.0f, 1.0f);
@@ -667,7 +1482,7 @@ void GUI_DrawListbox(float x, float y, float w, float h, float item_height, cons
 
     GUI_DrawRect(x, y, w, h, bg_1);
 
-    while(item_y < y+h && index < data.size())
+    while(item_y < y+h && index < count)
     {
         if(index == choice)
             GUI_DrawRect(item_x, item_y, w, item_height, choice_col);
@@ -675,14 +1490,64 @@ void GUI_DrawListbox(float x, float y, float w, float h, float item_height, cons
             GUI_DrawRect(item_x, item_y, w, item_height, bg_2);
 
 
-        GUI_DrawText(item_x, item_y, data[index].c_str());
+        const char *str = text(index, user);
+        GUI_DrawTextAligned(item_x, item_y, 0.0f, 0.0f, GUI_ALIGN_LEFT, GUI_ALIGN_TOP, str, strlen(str));
 
         index++;
         item_y += item_height;
     }
 }
 
-void GUI_DrawListboxMulti(float x, float y, float w, float h, float item_height, const std::vector<std::string> &data, int data_offset, const std::vector<bool> &selected)
+/*
+ * Rows of differing height, scrolled down by scroll pixels. A row's text is
+ * split into lines at newlines, and only the lines that start inside the row
+ * are drawn.
+ */
+void GUI_DrawListboxRows(float x, float y, float w, float h, float line_h, int count, const char *(*text)(int row, void *user), void *user, const GUIRowHeights &heights, int scroll, int choice)
+{
+    cml::vector4f bg_1(131.0f/255.0f, 129.0f/255.0f, 131.0f/255.0f, 1.0f);
+    cml::vector4f bg_2(162.0f/255.0f, 165.0f/255.0f, 162.0f/255.0f, 1.0f);
+    cml::vector4f choice_col(49.0f/255.0f, 97.0f/255.0f, 131.0f/255.0f, 1.0f);
+
+    int   index = heights.rowAt(scroll);
+    float item_x = x;
+    float item_y = y + float(heights.rowY(index) - scroll);
+
+    GUI_DrawRect(x, y, w, h, bg_1);
+
+    while(item_y < y+h && index < count)
+    {
+        float item_h = heights.height(index);
+
+        if(index == choice)
+            GUI_DrawRect(item_x, item_y, w, item_h, choice_col);
+        else if(index % 2)
+            GUI_DrawRect(item_x, item_y, w, item_h, bg_2);
+
+        const char *str = text(index, user);
+        float line_y = item_y;
+
+        for(;;)
+        {
+            const char *nl = strchr(str, '\n');
+            size_t len = nl != NULL ? size_t(nl - str) : strlen(str);
+
+            GUI_DrawTextAligned(item_x, line_y, 0.0f, 0.0f, GUI_ALIGN_LEFT, GUI_ALIGN_TOP, str, len);
+
+            line_y += line_h;
+
+            if(nl == NULL || line_y >= item_y + item_h || line_y >= y+h)
+                break;
+
+            str = nl + 1;
+        }
+
+        index++;
+        item_y += item_h;
+    }
+}
+
+void GUI_DrawListboxMulti(float x, float y, float w, float h, float item_height, int count, const char *(*text)(int row, void *user), void *user, int data_offset, const GUISelection &selected)
 {
     cml::vector4f bg_1(131.0f/255.0f, 129.0f/255.0f, 131.0f/255.0f, 1.0f);
     cml::vector4f bg_2(162.0f/255.0f, 165.0f/255.0f, 162.0f/255.0f, 1.0f);
@@ -694,14 +1559,15 @@ void GUI_DrawListboxMulti(float x, float y, float w, float h, float item_height,
 
     GUI_DrawRect(x, y, w, h, bg_1);
 
-    while(item_y < y+h && index < data.size())
+    while(item_y < y+h && index < count)
     {
-        if(selected[index])
+        if(selected.isSelected(index))
             GUI_DrawRect(item_x, item_y, w, item_height, choice_col);
         else if(index % 2)
             GUI_DrawRect(item_x, item_y, w, item_height, bg_2);
 
-        GUI_DrawText(item_x, item_y, data[index].c_str());
+        const char *str = text(index, user);
+        GUI_DrawTextAligned(item_x, item_y, 0.0f, 0.0f, GUI_ALIGN_LEFT, GUI_ALIGN_TOP, str, strlen(str));
 
         index++;
         item_y += item_height;
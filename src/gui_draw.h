@@ -4,23 +4,33 @@
 #include <vector>
 #include <string>
 
+struct GUITextBuffer;
+struct GUILog;
+struct GUIMappedFile;
+struct GUISelection;
+struct GUIRowHeights;
+
+void GUI_GL_BeginFrame();
+void GUI_GL_EndFrame();
+void GUI_GL_Flush();
+
 void GUI_GL_Translate(float x, float y);
 void GUI_GL_SetTranslation(float x, float y);
 void GUI_GL_PushTranslation();
 void GUI_GL_PopTranslation();
 void GUI_GL_SetClipRect(float x, float y, float w, float h);
 
-void GUI_GL_Line(float x1, float y1, float x2, float y2);
+void GUI_GL_Line(float x1, float y1, float x2, float y2, const cml::vector4f &col);
 void GUI_GL_Triangle(float x0, float y0, float x1, float y1, float x2, float y2, const cml::vector4f &col);
 void GUI_GL_Rect(float x, float y, float w, float h, const cml::vector4f &col);
 void GUI_GL_RectOutline(float x, float y, float w, float h, float thickness, const cml::vector4f &col);
 void GUI_GL_RectRaised(float x, float y, float w, float h, float border, const cml::vector4f &shade1, const cml::vector4f &shade2, const cml::vector4f &fill_col);
 void GUI_GL_RectTextured(float x, float y, float w, float h, float tminx, float tminy, float tmaxx, float tmaxy, GLuint tex_id, const cml::vector4f &col);
-void GUI_GL_TextAligned(float x, float y, float w, float h, int horz, int vert, sf::Font *font, int font_size, const cml::vector4f &font_col, const std::string &str);
+void GUI_GL_TextAligned(float x, float y, float w, float h, int horz, int vert, sf::Font *font, int font_size, const cml::vector4f &font_col, const char *str, size_t len);
 
 
 void GUI_DrawBegin();
-void GUI_DrawEnd();
+bool GUI_DrawEnd();
 
 void GUI_DrawSetLayer(int layer);
 
@@ -43,15 +53,20 @@ void GUI_DrawRectRaised(float x, float y, float w, float h, float border, const
 void GUI_DrawRectTextured(float x, float y, float w, float h, float tminx, float tminy, float tmaxx, float tmaxy, GLuint tex_id, const cml::vector4f &col);
 void GUI_DrawText(float x, float y, const std::string &str);
 void GUI_DrawTextAligned(float x, float y, float w, float h, int horz, int vert, const std::string &str);
+void GUI_DrawTextAligned(float x, float y, float w, float h, int horz, int vert, const char *str, size_t len);
 void GUI_DrawArrow(float x, float y, float w, float h, int dir, const cml::vector4f &col);
 
 void GUI_DrawLabel(float x, float y, float w, float h, const std::string &str);
 void GUI_DrawButton(float x, float y, float w, float h, bool hot, bool active, const std::string &str);
 void GUI_DrawCheckbox(float x, float y, float w, float h, bool selected);
 void GUI_DrawCheckboxLabelled(float x, float y, float w, float h, float cx, float cy, float cw, float ch, bool hot, const std::string &str, bool selected);
-void GUI_DrawEditBox(float x, float y, float w, float h, bool active, int caret_pos, int selection, float str_offset, const std::string &str);
-void GUI_DrawListbox(float x, float y, float w, float h, float item_height, const std::vector<std::string> &data, int data_offset, int choice);
-void GUI_DrawListboxMulti(float x, float y, float w, float h, float item_height, const std::vector<std::string> &data, int data_offset, const std::vector<bool> &selected);
+void GUI_DrawEditBox(float x, float y, float w, float h, bool active, int caret_pos, int selection, float str_offset, const std::string &str, const std::vector<float> *pos);
+void GUI_DrawTextEditor(float x, float y, float w, float h, bool active, float line_h, float offset, const GUITextBuffer &text, size_t first_line, size_t caret, size_t anchor);
+void GUI_DrawLogConsole(float x, float y, float w, float h, float line_h, const GUILog &log, size_t first_row);
+void GUI_DrawFileViewer(float x, float y, float w, float h, float line_h, GUIMappedFile &file, size_t first_row, size_t rows, float progress);
+void GUI_DrawListbox(float x, float y, float w, float h, float item_height, int count, const char *(*text)(int row, void *user), void *user, int data_offset, int choice);
+void GUI_DrawListboxMulti(float x, float y, float w, float h, float item_height, int count, const char *(*text)(int row, void *user), void *user, int data_offset, const GUISelection &selected);
+void GUI_DrawListboxRows(float x, float y, float w, float h, float line_h, int count, const char *(*text)(int row, void *user), void *user, const GUIRowHeights &heights, int scroll, int choice);
 void GUI_DrawDropListHeader(float x, float y, float w, float h, bool open, const std::string &text);
 void GUI_DrawSlider(float x, float y, float w, float h, float thumb_x, float thumb_y, float thumb_w, float thumb_h); 
 
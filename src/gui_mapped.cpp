@@ -0,0 +1,254 @@
+#include <string.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <cml/cml.h>
+#include <SFML/System.hpp>
+#include <SFML/Window.hpp>
+#include <SFML/Graphics.hpp>
+
+#include "gui.h"
+
+
+/*--------------------------------------------------------------------------*
+ *
+ * Mapped file line index. Line 0 starts at 0 and every newline starts
+ * another line. Chunk c holds the starts that follow the newlines inside it
+ * as offsets from its begin, and those lines are numbered from first. Workers
+ * take chunks in file order. ready only advances over a run of finished
+ * chunks, so lines [0, ready_lines) can be read while later chunks are still
+ * being scanned. A finished chunk is never written to again.
+ *
+ *--------------------------------------------------------------------------*/
+#define MAPPED_CHUNK_SIZE (16 * 1024 * 1024)
+
+GUIMappedFile::GUIMappedFile()
+{
+    data = NULL;
+    length = 0;
+    is_open = false;
+    next_chunk = ready = 0;
+    ready_lines = 1;
+    scanned = 0;
+    cancel = false;
+}
+
+GUIMappedFile::~GUIMappedFile()
+{
+    close();
+}
+
+bool GUIMappedFile::open(const std::string &path, int threads)
+{
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+        return false;
+
+    struct stat st;
+    if(fstat(fd, &st) != 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    length = st.st_size;
+
+    if(length > 0)
+    {
+        void *p = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if(p == MAP_FAILED)
+        {
+            ::close(fd);
+            length = 0;
+            return false;
+        }
+
+        madvise(p, length, MADV_SEQUENTIAL);
+        data = (const char*)p;
+    }
+
+    /* the mapping keeps the file open */
+    ::close(fd);
+
+    for(size_t b = 0; b < length; b += MAPPED_CHUNK_SIZE)
+    {
+        Chunk c;
+        c.begin = b;
+        c.end = std::min(b + MAPPED_CHUNK_SIZE, length);
+        c.first = 0;
+        c.done = false;
+        chunks.push_back(c);
+    }
+
+    next_chunk = ready = 0;
+    ready_lines = 1;
+    scanned = 0;
+    cancel = false;
+    is_open = true;
+
+    threads = std::min(std::max(threads, 1), (int)chunks.size());
+
+    for(int i = 0; i < threads; i++)
+    {
+        workers.push_back(new sf::Thread(&GUIMappedFile::worker, this));
+        workers.back()->Launch();
+    }
+
+    return true;
+}
+
+void GUIMappedFile::close()
+{
+    {
+        sf::Lock lock(mutex);
+        cancel = true;
+    }
+
+    for(size_t i = 0; i < workers.size(); i++)
+    {
+        workers[i]->Wait();
+        delete workers[i];
+    }
+
+    workers.clear();
+
+    if(data != NULL)
+        munmap((void*)data, length);
+
+    data = NULL;
+    length = 0;
+    is_open = false;
+    chunks.clear();
+    next_chunk = ready = 0;
+    ready_lines = 1;
+    scanned = 0;
+}
+
+void GUIMappedFile::worker(void *p)
+{
+    GUIMappedFile *f = (GUIMappedFile*)p;
+
+    for(;;)
+    {
+        size_t i;
+
+        {
+            sf::Lock lock(f->mutex);
+
+            if(f->cancel || f->next_chunk == f->chunks.size())
+                return;
+
+            i = f->next_chunk++;
+        }
+
+        Chunk &c = f->chunks[i];
+        const char *begin = f->data + c.begin;
+        const char *end = f->data + c.end;
+        const char *s = begin;
+
+        while((s = (const char*)memchr(s, '\n', end - s)) != NULL)
+        {
+            s++;
+            c.starts.push_back(s - begin);
+        }
+
+        c.starts.shrink_to_fit();
+
+        /* the pages are only needed again for the lines that get drawn */
+        madvise((void*)begin, end - begin, MADV_DONTNEED);
+
+        sf::Lock lock(f->mutex);
+
+        c.done = true;
+        f->scanned += c.end - c.begin;
+
+        while(f->ready < f->chunks.size() && f->chunks[f->ready].done)
+        {
+            Chunk &r = f->chunks[f->ready];
+            r.first = f->ready_lines;
+            f->ready_lines += r.starts.size();
+            f->ready++;
+        }
+    }
+}
+
+bool GUIMappedFile::isOpen() const
+{
+    return is_open;
+}
+
+bool GUIMappedFile::indexed()
+{
+    sf::Lock lock(mutex);
+    return ready == chunks.size();
+}
+
+float GUIMappedFile::progress()
+{
+    sf::Lock lock(mutex);
+    return length > 0 ? (float)scanned / length : 1.0f;
+}
+
+/*
+ * Until indexing is done the end of the last line read so far isn't known,
+ * so it isn't counted. A newline at the very end doesn't start another line.
+ */
+size_t GUIMappedFile::lineCount()
+{
+    sf::Lock lock(mutex);
+
+    if(length == 0)
+        return 0;
+
+    if(ready < chunks.size())
+        return ready_lines - 1;
+
+    return lineStart(ready_lines - 1) == length ? ready_lines - 1 : ready_lines;
+}
+
+/* row must be below ready_lines */
+size_t GUIMappedFile::lineStart(size_t row) const
+{
+    if(row == 0)
+        return 0;
+
+    /* last ready chunk whose lines start at or before row */
+    size_t lo = 0, hi = ready;
+
+    while(hi - lo > 1)
+    {
+        size_t mid = (lo + hi) / 2;
+
+        if(chunks[mid].first <= row)
+            lo = mid;
+        else
+            hi = mid;
+    }
+
+    const Chunk &c = chunks[lo];
+    return c.begin + c.starts[row - c.first];
+}
+
+const char *GUIMappedFile::line(size_t row, size_t *len)
+{
+    sf::Lock lock(mutex);
+
+    size_t start = lineStart(row);
+    size_t end = row + 1 < ready_lines ? lineStart(row + 1) - 1 : length;
+
+    if(end > start && data[end - 1] == '\r')
+        end--;
+
+    *len = end - start;
+    return data + start;
+}
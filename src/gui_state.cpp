@@ -0,0 +1,316 @@
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <iostream>
+#include <algorithm>
+
+#include <cml/cml.h>
+#include <SFML/Window.hpp>
+#include <SFML/Graphics.hpp>
+
+#include "gui.h"
+#include "gui_state.h"
+
+
+/*--------------------------------------------------------------------------*
+ *
+ * Pool allocator. Blocks are handed out from size classes of 16 to 1024
+ * bytes carved out of larger chunks. Freed blocks go on a per class free list
+ * and are reused, so steady state widget churn doesn't touch the heap.
+ * Anything bigger than the largest class goes straight to malloc.
+ *
+ *--------------------------------------------------------------------------*/
+#define POOL_MIN_SHIFT   4
+#define POOL_NUM_CLASSES 7
+#define POOL_CHUNK_SIZE  (64 * 1024)
+
+struct PoolBlock
+{
+    PoolBlock *next;
+};
+
+static PoolBlock *pool_free[POOL_NUM_CLASSES];
+static std::vector<char*> pool_chunks;
+static size_t pool_chunk_used = POOL_CHUNK_SIZE;
+static size_t pool_bytes = 0;
+
+static int poolClass(size_t size)
+{
+    int c = 0;
+
+    while(c < POOL_NUM_CLASSES && (size_t(1) << (c + POOL_MIN_SHIFT)) < size)
+        c++;
+
+    return c;
+}
+
+static void *poolAlloc(size_t size)
+{
+    int c = poolClass(size);
+
+    if(c == POOL_NUM_CLASSES)
+    {
+        pool_bytes += size;
+        return malloc(size);
+    }
+
+    if(pool_free[c] != NULL)
+    {
+        PoolBlock *b = pool_free[c];
+        pool_free[c] = b->next;
+        return b;
+    }
+
+    size_t block_size = size_t(1) << (c + POOL_MIN_SHIFT);
+
+    if(pool_chunk_used + block_size > POOL_CHUNK_SIZE)
+    {
+        pool_chunks.push_back((char*)malloc(POOL_CHUNK_SIZE));
+        pool_chunk_used = 0;
+        pool_bytes += POOL_CHUNK_SIZE;
+    }
+
+    void *p = pool_chunks.back() + pool_chunk_used;
+    pool_chunk_used += block_size;
+    return p;
+}
+
+static void poolFree(void *p, size_t size)
+{
+    int c = poolClass(size);
+
+    if(c == POOL_NUM_CLASSES)
+    {
+        pool_bytes -= size;
+        free(p);
+        return;
+    }
+
+    PoolBlock *b = (PoolBlock*)p;
+    b->next = pool_free[c];
+    pool_free[c] = b;
+}
+
+
+
+/*--------------------------------------------------------------------------*
+ *
+ * Open addressing hash table with linear probing. Widget ids are already
+ * hashes so the low bits are used directly as the home slot. A key of 0 marks
+ * an empty slot. Removal shifts following entries back instead of leaving
+ * tombstones.
+ *
+ *--------------------------------------------------------------------------*/
+struct StateEntry
+{
+    GUIHash key;
+    unsigned int last_frame;
+    size_t size;
+    void *data;
+    void (*destroy)(void*);
+};
+
+static std::vector<StateEntry> table;
+static size_t table_count = 0;
+static size_t total_evictions = 0;
+static unsigned int frame = 0;
+static unsigned int max_age = 120;
+
+static size_t slotOf(GUIHash key)
+{
+    return size_t(key) & (table.size() - 1);
+}
+
+static void destroyEntry(StateEntry &e)
+{
+    e.destroy(e.data);
+    poolFree(e.data, e.size);
+}
+
+static void insertEntry(const StateEntry &e)
+{
+    size_t i = slotOf(e.key);
+
+    while(table[i].key != 0)
+        i = (i + 1) & (table.size() - 1);
+
+    table[i] = e;
+}
+
+static void grow()
+{
+    std::vector<StateEntry> old;
+    old.swap(table);
+
+    StateEntry empty;
+    memset(&empty, 0, sizeof(empty));
+    table.resize(old.empty() ? 256 : old.size() * 2, empty);
+
+    for(size_t i = 0; i < old.size(); i++)
+        if(old[i].key != 0)
+            insertEntry(old[i]);
+}
+
+static size_t findSlot(GUIHash key)
+{
+    if(table.empty())
+        return size_t(-1);
+
+    size_t i = slotOf(key);
+
+    while(table[i].key != 0)
+    {
+        if(table[i].key == key)
+            return i;
+        i = (i + 1) & (table.size() - 1);
+    }
+
+    return size_t(-1);
+}
+
+static void removeSlot(size_t i)
+{
+    size_t mask = table.size() - 1;
+    size_t j = i;
+
+    table[i].key = 0;
+    table_count--;
+
+    /* move back any following entries that could have lived in the hole */
+    for(;;)
+    {
+        j = (j + 1) & mask;
+
+        if(table[j].key == 0)
+            break;
+
+        size_t home = slotOf(table[j].key);
+
+        /* entry at j stays put if its home lies cyclically in (i, j] */
+        bool stays = (i <= j) ? (i < home && home <= j) : (i < home || home <= j);
+
+        if(!stays)
+        {
+            table[i] = table[j];
+            table[j].key = 0;
+            i = j;
+        }
+    }
+}
+
+void *GUI_StateLookup(GUIHash id, size_t size, void (*destroy)(void*), bool *created)
+{
+    size_t i = findSlot(id);
+
+    if(i != size_t(-1))
+    {
+        StateEntry &e = table[i];
+
+        if(e.destroy == destroy && e.size == size)
+        {
+            e.last_frame = frame;
+            *created = false;
+            return e.data;
+        }
+
+        /* same id used with a different type of state */
+        destroyEntry(e);
+        e.data = poolAlloc(size);
+        e.size = size;
+        e.destroy = destroy;
+        e.last_frame = frame;
+        *created = true;
+        return e.data;
+    }
+
+    if((table_count + 1) * 4 > table.size() * 3)
+        grow();
+
+    StateEntry e;
+    e.key = id;
+    e.last_frame = frame;
+    e.size = size;
+    e.data = poolAlloc(size);
+    e.destroy = destroy;
+
+    insertEntry(e);
+    table_count++;
+
+    *created = true;
+    return e.data;
+}
+
+void GUI_StateRemove(GUIHash id)
+{
+    size_t i = findSlot(id);
+
+    if(i == size_t(-1))
+        return;
+
+    destroyEntry(table[i]);
+    removeSlot(i);
+}
+
+/*
+ * Called once per frame. Destroys any state that hasn't been looked up in the
+ * last max_age frames.
+ */
+void GUI_StateEndFrame()
+{
+    frame++;
+
+    size_t i = 0;
+
+    while(i < table.size())
+    {
+        StateEntry &e = table[i];
+
+        if(e.key != 0 && frame - e.last_frame > max_age)
+        {
+            destroyEntry(e);
+            removeSlot(i);
+            total_evictions++;
+
+            /* removeSlot may have moved another entry into slot i */
+            continue;
+        }
+
+        i++;
+    }
+}
+
+unsigned int GUI_StateFrame()
+{
+    return frame;
+}
+
+void GUI_StateClear()
+{
+    for(size_t i = 0; i < table.size(); i++)
+    {
+        if(table[i].key != 0)
+        {
+            destroyEntry(table[i]);
+            table[i].key = 0;
+        }
+    }
+
+    table_count = 0;
+}
+
+void GUI_StateMaxAge(int frames)
+{
+    max_age = std::max(frames, 1);
+}
+
+GUIStateStats GUI_GetStateStats()
+{
+    GUIStateStats s;
+    s.capacity = table.size();
+    s.count = table_count;
+    s.evictions = total_evictions;
+    s.pool_bytes = pool_bytes;
+    return s;
+}
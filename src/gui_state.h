@@ -0,0 +1,47 @@
+#ifndef GUI_STATE_H
+#define GUI_STATE_H
+
+#include <new>
+
+/*
+ * Persistent per-widget state, keyed by widget id.
+ *
+ * Widgets that need to remember something between passes and frames (caret,
+ * scroll position, open state) can ask the store for a block of memory
+ * instead of making the caller own it. Entries that haven't been looked up
+ * for a number of frames are destroyed when the frame ends.
+ */
+
+void *GUI_StateLookup(GUIHash id, size_t size, void (*destroy)(void*), bool *created);
+void  GUI_StateRemove(GUIHash id);
+void  GUI_StateEndFrame();
+void  GUI_StateClear();
+
+/* counts frames, going up each time GUI_StateEndFrame() is called */
+unsigned int GUI_StateFrame();
+
+template<class T> void GUI_StateDestroy(void *p)
+{
+    ((T*)p)->~T();
+}
+
+/*
+ * Returns the state of type T for the widget, default constructing it the
+ * first time it is asked for. Asking for a different type under the same id
+ * replaces the old state.
+ */
+template<class T> T* GUI_GetState(GUIID id, bool *created = NULL)
+{
+    bool is_new;
+    void *p = GUI_StateLookup(id.hash, sizeof(T), &GUI_StateDestroy<T>, &is_new);
+
+    if(is_new)
+        new(p) T();
+
+    if(created != NULL)
+        *created = is_new;
+
+    return (T*)p;
+}
+
+#endif /* GUI_STATE_H */
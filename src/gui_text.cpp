@@ -0,0 +1,255 @@
+#include <string.h>
+#include <string>
+#include <vector>
+#include <list>
+#include <map>
+#include <iostream>
+#include <algorithm>
+
+#include <cml/cml.h>
+#include <SFML/Window.hpp>
+#include <SFML/Graphics.hpp>
+
+#include "gui.h"
+#include "gui_text.h"
+
+
+/*--------------------------------------------------------------------------*
+ *
+ * Glyph tables.
+ *
+ *--------------------------------------------------------------------------*/
+static std::map<const sf::Font*, GUIGlyphTable*> glyph_tables;
+static unsigned int font_generation = 0;
+
+const GUIGlyphTable *GUI_GlyphTable(const sf::Font *font)
+{
+    std::map<const sf::Font*, GUIGlyphTable*>::iterator it = glyph_tables.find(font);
+
+    if(it != glyph_tables.end())
+        return it->second;
+
+    GUIGlyphTable *t = new GUIGlyphTable;
+    t->char_size = font->GetCharacterSize();
+
+    for(int c = 0; c < 256; c++)
+        t->glyphs[c] = font->GetGlyph(c);
+
+    glyph_tables[font] = t;
+    return t;
+}
+
+
+
+unsigned int GUI_DecodeUTF8(const char *str, size_t len, size_t *i)
+{
+    unsigned char c = str[*i];
+
+    if(c < 0x80)
+    {
+        (*i)++;
+        return c;
+    }
+
+    /* number of continuation bytes */
+    int n = c < 0xc0 ? -1 : c < 0xe0 ? 1 : c < 0xf0 ? 2 : c < 0xf8 ? 3 : -1;
+
+    if(n < 0 || *i + n >= len)
+    {
+        (*i)++;
+        return 0xfffd;
+    }
+
+    unsigned int cp = c & (0x7f >> (n + 1));
+
+    for(int k = 1; k <= n; k++)
+    {
+        unsigned char b = str[*i + k];
+
+        if((b & 0xc0) != 0x80)
+        {
+            (*i)++;
+            return 0xfffd;
+        }
+
+        cp = (cp << 6) | (b & 0x3f);
+    }
+
+    *i += n + 1;
+    return cp;
+}
+
+
+
+/*--------------------------------------------------------------------------*
+ *
+ * Text metrics cache. Entries live in a list ordered from most to least
+ * recently used, with a map from key to list position. A hit moves the entry
+ * to the front and a miss past the capacity reuses the entry at the back.
+ *
+ *--------------------------------------------------------------------------*/
+struct MetricsEntry
+{
+    GUIHash key;
+    const sf::Font *font;
+    size_t len;
+    GUITextMetrics metrics;
+};
+
+typedef std::list<MetricsEntry> MetricsList;
+
+static MetricsList metrics_lru;
+static std::map<GUIHash, MetricsList::iterator> metrics_map;
+static size_t metrics_capacity = 1024;
+static GUITextCacheStats metrics_stats;
+
+static void measure(const sf::Font *font, int size, const char *str, size_t len, GUITextMetrics *m)
+{
+    const GUIGlyphTable *t = GUI_GlyphTable(font);
+    float scale = size / t->char_size;
+    float space = t->glyphs[' '].Advance;
+    float x = 0.0f;
+    int lines = 1;
+
+    m->width = 0.0f;
+    m->pos.resize(len + 1);
+
+    size_t i = 0;
+
+    while(i < len)
+    {
+        size_t start = i;
+        unsigned int c = GUI_DecodeUTF8(str, len, &i);
+
+        for(size_t j = start; j < i; j++)
+            m->pos[j] = x * scale;
+
+        if(c == '\n')
+        {
+            m->width = std::max(m->width, x * scale);
+            x = 0.0f;
+            lines++;
+        }
+        else if(c == '\t')
+            x += space * 4.0f;
+        else
+            x += GUI_Glyph(font, t, c).Advance;
+    }
+
+    m->pos[len] = x * scale;
+    m->width = std::max(m->width, x * scale);
+    m->height = lines * size;
+}
+
+const GUITextMetrics &GUI_TextMetrics(const sf::Font *font, int size, const char *str, size_t len)
+{
+    GUIHash key = GUI_HashBytes(str, len);
+    key = GUI_HashBytes((const char*)&font, sizeof(font), key);
+    key = GUI_HashBytes((const char*)&size, sizeof(size), key);
+
+    std::map<GUIHash, MetricsList::iterator>::iterator it = metrics_map.find(key);
+
+    if(it != metrics_map.end() && it->second->len == len)
+    {
+        metrics_stats.hits++;
+        metrics_lru.splice(metrics_lru.begin(), metrics_lru, it->second);
+        return it->second->metrics;
+    }
+
+    metrics_stats.misses++;
+
+    if(it != metrics_map.end())
+    {
+        /* hash collision with a different length string, replace it */
+        metrics_lru.splice(metrics_lru.begin(), metrics_lru, it->second);
+    }
+    else if(metrics_lru.size() >= metrics_capacity)
+    {
+        /* reuse the least recently used entry and its pos storage */
+        metrics_map.erase(metrics_lru.back().key);
+        metrics_lru.splice(metrics_lru.begin(), metrics_lru, --metrics_lru.end());
+        metrics_map[key] = metrics_lru.begin();
+        metrics_stats.evictions++;
+    }
+    else
+    {
+        metrics_lru.push_front(MetricsEntry());
+        metrics_map[key] = metrics_lru.begin();
+    }
+
+    MetricsEntry &e = metrics_lru.front();
+    e.key = key;
+    e.font = font;
+    e.len = len;
+    measure(font, size, str, len, &e.metrics);
+
+    return e.metrics;
+}
+
+void GUI_TextCacheSize(int entries)
+{
+    metrics_capacity = std::max(entries, 1);
+
+    while(metrics_lru.size() > metrics_capacity)
+    {
+        metrics_map.erase(metrics_lru.back().key);
+        metrics_lru.pop_back();
+        metrics_stats.evictions++;
+    }
+}
+
+unsigned int GUI_FontGeneration()
+{
+    return font_generation;
+}
+
+void GUI_ForgetFont(const sf::Font *font)
+{
+    std::map<const sf::Font*, GUIGlyphTable*>::iterator it = glyph_tables.find(font);
+
+    if(it != glyph_tables.end())
+    {
+        delete it->second;
+        glyph_tables.erase(it);
+    }
+
+    MetricsList::iterator e = metrics_lru.begin();
+
+    while(e != metrics_lru.end())
+    {
+        if(e->font == font)
+        {
+            metrics_map.erase(e->key);
+            e = metrics_lru.erase(e);
+        }
+        else
+        {
+            ++e;
+        }
+    }
+
+    font_generation++;
+    GUI_RequestRedraw();
+}
+
+void GUI_ForgetFonts()
+{
+    std::map<const sf::Font*, GUIGlyphTable*>::iterator it;
+
+    for(it = glyph_tables.begin(); it != glyph_tables.end(); ++it)
+        delete it->second;
+
+    glyph_tables.clear();
+    metrics_lru.clear();
+    metrics_map.clear();
+
+    font_generation++;
+}
+
+GUITextCacheStats GUI_GetTextCacheStats()
+{
+    GUITextCacheStats s = metrics_stats;
+    s.count = metrics_lru.size();
+    s.capacity = metrics_capacity;
+    return s;
+}
@@ -0,0 +1,61 @@
+#ifndef GUI_TEXT_H
+#define GUI_TEXT_H
+
+#include <vector>
+
+/*
+ * Glyphs and text measurement shared by widget layout, the response pass and
+ * drawing.
+ *
+ * SFML rasterizes a font once at the size it was loaded with and scales it
+ * for other sizes. The first 256 glyphs of each font are copied into a flat
+ * table so measuring and drawing don't go through the font's glyph map.
+ */
+struct GUIGlyphTable
+{
+    float char_size;
+    sf::Glyph glyphs[256];
+};
+
+const GUIGlyphTable *GUI_GlyphTable(const sf::Font *font);
+
+/*
+ * Changes whenever a font is forgotten, so anything that keeps glyph
+ * positions around can tell they may be stale.
+ */
+unsigned int GUI_FontGeneration();
+
+/* glyph for a code point, from the table when it's one of the first 256 */
+inline const sf::Glyph &GUI_Glyph(const sf::Font *font, const GUIGlyphTable *t, unsigned int c)
+{
+    return c < 256 ? t->glyphs[c] : font->GetGlyph(c);
+}
+
+/*
+ * Text is UTF-8. Decodes the character starting at str[*i] and moves *i past
+ * it. A malformed sequence decodes as U+FFFD and only skips one byte.
+ */
+unsigned int GUI_DecodeUTF8(const char *str, size_t len, size_t *i);
+
+/*
+ * Metrics of a string at a font size. pos has one more entry than the string
+ * has bytes: pos[i] is the x position of character i (where a caret before it
+ * goes) and the last entry is the end of the string. All the bytes of a
+ * multi-byte character share the position of its first byte. A newline
+ * starts pos back at 0.
+ */
+struct GUITextMetrics
+{
+    float width;
+    float height;
+    std::vector<float> pos;
+};
+
+/*
+ * Returns the metrics from a bounded LRU cache keyed by (font, size, string
+ * hash), measuring the string on a miss. The reference is only good until
+ * the next call.
+ */
+const GUITextMetrics &GUI_TextMetrics(const sf::Font *font, int size, const char *str, size_t len);
+
+#endif /* GUI_TEXT_H */
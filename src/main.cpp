@@ -16,6 +16,9 @@
 sf::RenderWindow window;
 bool running = true;
 
+/* run the GUI with GUI_PASS_SINGLE instead of separate event/response/draw passes */
+bool single_pass = false;
+
 std::vector<std::string> list_data;
 
 
@@ -35,18 +38,30 @@ int main()
     GUI_Init();
     GUI_ScreenBounds(0, 0, 800, 600);
 
+    /* every widget in the demo hot tests in the draw pass */
+    GUI_HoverIndex(true);
+
     while(running)
     {
         doEvents();
 
+        /* nothing changed, don't redraw until there's input */
+        if(!GUI_NeedsRedraw())
+        {
+            sf::Sleep(1.0f / 60.0f);
+            continue;
+        }
+
         glClear(GL_COLOR_BUFFER_BIT);
 
 
-        doGUI(GUI_PASS_DRAW);
+        doGUI(single_pass ? GUI_PASS_SINGLE : GUI_PASS_DRAW);
 
         window.Display();
     }
 
+    GUI_ForgetFonts();
+
     return 0;
 }
 
@@ -61,9 +76,7 @@ void doEvents()
             {
                 if(e.Key.Code == sf::Key::Escape)
                     running = false;
-                GUI_KeyPressed(e.Key.Code, e.Key.Control, e.Key.Alt, e.Key.Shift);
-                doGUI(GUI_PASS_EVENT);
-                doGUI(GUI_PASS_RESPONSE);
+                GUI_QueueKeyPressed(e.Key.Code, e.Key.Control, e.Key.Alt, e.Key.Shift);
                 break;
             }
             case sf::Event::KeyReleased:
@@ -72,37 +85,33 @@ void doEvents()
             }
             case sf::Event::MouseMoved:
             {
-                GUI_MouseMove(e.MouseMove.X, e.MouseMove.Y);
-                doGUI(GUI_PASS_EVENT);
-                doGUI(GUI_PASS_RESPONSE);
+                GUI_QueueMouseMove(e.MouseMove.X, e.MouseMove.Y);
                 break;
             }
             case sf::Event::MouseButtonPressed:
             {
-                GUI_MouseButton(e.MouseButton.Button, true);
-                doGUI(GUI_PASS_EVENT);
-                doGUI(GUI_PASS_RESPONSE);
+                GUI_QueueMouseButton(e.MouseButton.Button, true);
                 break;
             }
             case sf::Event::MouseButtonReleased:
             {
-                GUI_MouseButton(e.MouseButton.Button, false);
-                doGUI(GUI_PASS_EVENT);
-                doGUI(GUI_PASS_RESPONSE);
+                GUI_QueueMouseButton(e.MouseButton.Button, false);
                 break;
             }
             case sf::Event::MouseWheelMoved:
             {
-                GUI_MouseWheel(e.MouseWheel.Delta > 0.0f ? 1 : -1);
-                doGUI(GUI_PASS_EVENT);
-                doGUI(GUI_PASS_RESPONSE);
+                GUI_QueueMouseWheel(e.MouseWheel.Delta > 0.0f ? 1 : -1);
                 break;
             }
             case sf::Event::TextEntered:
             {
-                GUI_KeyTyped(e.Text.Unicode);
-                doGUI(GUI_PASS_EVENT);
-                doGUI(GUI_PASS_RESPONSE);
+                GUI_QueueKeyTyped(e.Text.Unicode);
+                break;
+            }
+            case sf::Event::Resized:
+            case sf::Event::GainedFocus:
+            {
+                GUI_RequestRedraw();
                 break;
             }
             case sf::Event::Closed:
@@ -112,6 +121,8 @@ void doEvents()
                 break;
         }
     }
+
+    GUI_ProcessInput(doGUI, 32);
 }
 
 void doGUI(int pass)
@@ -149,6 +160,16 @@ void doGUI(int pass)
 
     GUI_Label("", 0, 128+24, 256, 24, "Sprite Chooser:");
 
+    static const char notes_str[] = "Notes\n\nThe editor only lays out\nthe lines in view.\n";
+    static GUITextEditorData notes;
+    static bool notes_made = false;
+    if(!notes_made)
+    {
+        notes.text.assign(notes_str, sizeof(notes_str)-1);
+        notes_made = true;
+    }
+    GUI_TextEditor("tile/notes", 0, 200, 256, 200, &notes);
+
     GUI_EndGroup();
 
 
@@ -162,6 +183,16 @@ void doGUI(int pass)
 
     GUI_CheckboxLabelled("checkbox1", 200, 200, 100, 16, "checkbox", &b1);
 
+    /* scrolling moves the edit box and everything drawn after it */
+    if(GUI_BeginScrollArea("area0", 420, 30, 120, 200, 16, 0, 0, 0, 400, &area_scrolls))
+    {
+        GUI_Label("", 0, 0, 100, 24, "Scrolled:");
+        GUI_EditBox("area0/edit0", 0, 24, 100, 24, &edit0_str);
+        GUI_Button("area0/button0", 0, 60, 64, 24, "");
+        GUI_CheckboxLabelled("area0/checkbox0", 0, 100, 100, 16, "checkbox", &b1);
+    }
+    GUI_EndScrollArea();
+
     static bool drop_open = false;
     GUI_DropList("droplist1", 200, 300, 100, 16, list_data, &lb_choice, &drop_open);
     GUI_Button("tile/delete2", 200, 316, 200, 24, "");
@@ -169,7 +200,8 @@ void doGUI(int pass)
 
     static float win1x = 200.0f;
     static float win1y = 400.0f;
-    GUI_BeginWindow("window1", &win1x, &win1y, 200, 200, "Test Window");
+    if(GUI_BeginWindow("window1", &win1x, &win1y, 200, 200, "Test Window"))
+    {
         GUI_Button("window1/button1", 0, 0, 20, 20, "");
         static int edit0_caret = 0;
         static int edit0_selection = 0;
@@ -183,6 +215,7 @@ void doGUI(int pass)
         static int spini1 = 1;
         static GUISpinnerData spin1_data = GUI_CreateSpinnerData(spini1);
         GUI_Spinner("window1/spin1", 0, 50+25, 100, 24, &spin1_data, -10, 10, &spini1);
+    }
     GUI_EndWindow();
 
     doMenubar();